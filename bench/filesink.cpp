@@ -0,0 +1,106 @@
+#include "../log.h"
+
+// Compares the ofstream file path against the io_uring sink, first on preformatted records so only the I/O is
+// measured, then end to end through LG_INFO.
+
+namespace
+{
+    const int RECORDS = 200000;
+    const int LOGGED_RECORDS = 2000;
+
+    template <typename Function>
+    double timeIt(Function function)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        function();
+
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void report(const std::string &name, const double milliseconds, const int records)
+    {
+        std::cout << std::left << std::setw(34) << name << std::right << std::setw(10) << std::fixed << std::setprecision(1) << milliseconds << " ms"
+                  << std::setw(12) << static_cast<long>(records / (milliseconds / 1000.0)) << " records/s\n";
+    }
+
+    std::string sampleRecord(const int i)
+    {
+        return "\\hspace{\\parindent} \\textcolor{loggerInfoColor}{[12:00:00] BENCH: request " + std::to_string(i) + " served in 42 us}\n\n";
+    }
+}
+
+int main()
+{
+    std::filesystem::create_directories("./bench_logs");
+
+    report("ofstream, reopened per record", timeIt([]()
+                                                   {
+                                                       std::ofstream file("./bench_logs/reopen.tex");
+                                                       file.close();
+
+                                                       for (int i = 0; i < RECORDS; i++)
+                                                       {
+                                                           file.open("./bench_logs/reopen.tex", std::ios::app);
+                                                           file << sampleRecord(i);
+                                                           file.close();
+                                                       } }),
+           RECORDS);
+
+    report("ofstream, kept open", timeIt([]()
+                                         {
+                                             std::ofstream file("./bench_logs/open.tex");
+
+                                             for (int i = 0; i < RECORDS; i++)
+                                                 file << sampleRecord(i); }),
+           RECORDS);
+
+    std::filesystem::remove("./bench_logs/uring.tex");
+
+    report("io_uring sink", timeIt([]()
+                                   {
+                                       Logging::UringFileSink sink("./bench_logs/uring.tex");
+
+                                       if (!sink.usingUring())
+                                           std::cout << "(io_uring unavailable, measuring the pwritev fallback)\n";
+
+                                       for (int i = 0; i < RECORDS; i++)
+                                           sink.write(sampleRecord(i)); }),
+           RECORDS);
+
+    std::filesystem::remove("./bench_logs/pwritev.tex");
+
+    report("pwritev fallback sink", timeIt([]()
+                                           {
+                                               Logging::UringFileSink sink("./bench_logs/pwritev.tex", 64 * 1024, 4, false);
+
+                                               for (int i = 0; i < RECORDS; i++)
+                                                   sink.write(sampleRecord(i)); }),
+           RECORDS);
+
+    Logging::Log log;
+
+    log.setFileSink(Logging::Log::FileSink::STREAM);
+    log.setLogInfo("./bench_logs", "logged_stream", "Bench");
+    log.setHeader("BENCH");
+
+    report("LG_INFO, ofstream path", timeIt([]()
+                                            {
+                                                for (int i = 0; i < LOGGED_RECORDS; i++)
+                                                    LG_INFO("request {0} served in {1} us", false, i, 42); }),
+           LOGGED_RECORDS);
+
+    log.setFileSink(Logging::Log::FileSink::URING);
+    log.setLogInfo("./bench_logs", "logged_uring", "Bench");
+    log.setHeader("BENCH");
+
+    report("LG_INFO, io_uring sink", timeIt([]()
+                                            {
+                                                for (int i = 0; i < LOGGED_RECORDS; i++)
+                                                    LG_INFO("request {0} served in {1} us", false, i, 42);
+
+                                                Logging::Log::flush(); }),
+           LOGGED_RECORDS);
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "../log.h"
+
+#include <random>
+
+// Compares the iostream path the {N:0.Nf} spec used to take, std::fixed and std::setprecision on the record's
+// stream, against the std::to_chars path behind Log::formatNumber. Every row formats the same values.
+
+namespace
+{
+    const int VALUES = 1000000;
+
+    template <typename Function>
+    double timeIt(Function function)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        function();
+
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void report(const std::string &name, const double milliseconds, const size_t bytes)
+    {
+        std::cout << std::left << std::setw(34) << name << std::right << std::setw(10) << std::fixed << std::setprecision(1) << milliseconds << " ms"
+                  << std::setw(14) << static_cast<long>(VALUES / (milliseconds / 1000.0)) << " values/s" << std::setw(12) << bytes << " bytes\n";
+    }
+
+    template <typename Function>
+    void run(const std::string &name, Function function)
+    {
+        size_t bytes = 0;
+
+        const double milliseconds = timeIt([&]()
+                                           { bytes = function(); });
+
+        report(name, milliseconds, bytes);
+    }
+
+    std::vector<double> sampleValues()
+    {
+        std::mt19937_64 generator(42);
+        std::lognormal_distribution<double> distribution(0.0, 4.0);
+
+        std::vector<double> values;
+
+        for (int i = 0; i < VALUES; i++)
+            values.push_back(i % 2 ? distribution(generator) : -distribution(generator));
+
+        return values;
+    }
+
+    // A record's worth of values per stream, as the logger builds one stream per record
+    size_t throughStream(const std::vector<double> &values, const int precision, const bool fixed)
+    {
+        size_t bytes = 0;
+
+        for (size_t i = 0; i < values.size(); i += 8)
+        {
+            std::ostringstream stream;
+
+            for (size_t j = i; j < i + 8 && j < values.size(); j++)
+            {
+                if (fixed)
+                    stream << std::fixed;
+
+                stream << std::setprecision(precision) << values[j] << ' ';
+            }
+
+            bytes += stream.str().length();
+        }
+
+        return bytes;
+    }
+
+    size_t throughFormatNumber(const std::vector<double> &values, const std::string &spec)
+    {
+        size_t bytes = 0;
+
+        for (size_t i = 0; i < values.size(); i += 8)
+        {
+            std::ostringstream stream;
+
+            for (size_t j = i; j < i + 8 && j < values.size(); j++)
+                stream << Logging::Log::formatNumber(values[j], spec) << ' ';
+
+            bytes += stream.str().length();
+        }
+
+        return bytes;
+    }
+}
+
+int main()
+{
+    const std::vector<double> values = sampleValues();
+
+    run("iostream, fixed 2", [&]()
+        { return throughStream(values, 2, true); });
+
+    run("to_chars, 0.2f", [&]()
+        { return throughFormatNumber(values, "0.2f"); });
+
+    run("iostream, fixed 12", [&]()
+        { return throughStream(values, 12, true); });
+
+    run("to_chars, 0.12f", [&]()
+        { return throughFormatNumber(values, "0.12f"); });
+
+    // max_digits10 is the fewest digits iostream can use and still round trip every value
+    run("iostream, round trip (17 digits)", [&]()
+        { return throughStream(values, std::numeric_limits<double>::max_digits10, false); });
+
+    run("to_chars, shortest round trip", [&]()
+        { return throughFormatNumber(values, ".g"); });
+
+    run("to_chars, grouped 0.2f", [&]()
+        { return throughFormatNumber(values, ",0.2f"); });
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "../log.h"
+
+// Producer scaling with every thread funnelled into the single log file versus one shard per core, first on
+// preformatted records so only the hand off and the I/O are measured, then end to end through LG_INFO, where
+// formatting the record dominates.
+
+namespace
+{
+    const int RECORDS_PER_THREAD = 100000;
+    const int LOGGED_RECORDS_PER_THREAD = 1000;
+
+    std::string sampleRecord(const unsigned thread, const int i)
+    {
+        return "\\hspace{\\parindent} \\textcolor{loggerInfoColor}{[12:00:00] BENCH: producer " + std::to_string(thread) + " request " + std::to_string(i) + " served in 42 us}\n\n";
+    }
+
+    template <typename Function>
+    double recordsPerSecond(const unsigned threads, const int records, Function function)
+    {
+        std::vector<std::thread> producers;
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (unsigned t = 0; t < threads; t++)
+            producers.emplace_back(function, t);
+
+        for (std::thread &producer : producers)
+            producer.join();
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return static_cast<double>(threads) * records / seconds;
+    }
+
+    double singleFile(const unsigned threads)
+    {
+        std::mutex fileMutex;
+        std::ofstream file("./bench_logs/preformatted.tex", std::ios::out | std::ios::trunc | std::ios::binary);
+
+        return recordsPerSecond(threads, RECORDS_PER_THREAD, [&](const unsigned t)
+                                {
+                                    for (int i = 0; i < RECORDS_PER_THREAD; i++)
+                                    {
+                                        const std::string record = sampleRecord(t, i);
+
+                                        std::lock_guard<std::mutex> lock(fileMutex);
+
+                                        file << record;
+                                    }
+
+                                    std::lock_guard<std::mutex> lock(fileMutex);
+
+                                    file.flush(); });
+    }
+
+    double sharded(const unsigned threads)
+    {
+        Logging::ShardedFileSink sink("./bench_logs/preformatted_sharded.tex", Logging::ShardedFileSink::Granularity::CORE, 4096, false);
+
+        return recordsPerSecond(threads, RECORDS_PER_THREAD, [&](const unsigned t)
+                                {
+                                    const Logging::RecordMeta meta;
+
+                                    for (int i = 0; i < RECORDS_PER_THREAD; i++)
+                                        sink.write(sampleRecord(t, i), meta);
+
+                                    sink.flush(); });
+    }
+
+    double logged(const unsigned threads)
+    {
+        return recordsPerSecond(threads, LOGGED_RECORDS_PER_THREAD, [](const unsigned t)
+                                {
+                                    for (int i = 0; i < LOGGED_RECORDS_PER_THREAD; i++)
+                                        LG_INFO("producer {0} request {1} served in {2} us", false, static_cast<int>(t), i, 42);
+
+                                    Logging::Log::flush(); });
+    }
+
+    void report(const unsigned threads, const double single, const double shardedRate)
+    {
+        std::cout << std::setw(8) << threads << std::setw(18) << static_cast<long>(single) << std::setw(18) << static_cast<long>(shardedRate) << std::setw(9) << std::fixed << std::setprecision(2) << shardedRate / single << "x\n";
+    }
+}
+
+int main()
+{
+    std::filesystem::create_directories("./bench_logs");
+
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+    std::cout << "preformatted records\n"
+              << std::setw(8) << "threads" << std::setw(18) << "single file/s" << std::setw(18) << "sharded/s" << std::setw(10) << "speedup\n";
+
+    for (unsigned threads = 1; threads <= cores; threads *= 2)
+        report(threads, singleFile(threads), sharded(threads));
+
+    Logging::Log log;
+
+    std::cout << "\nLG_INFO\n"
+              << std::setw(8) << "threads" << std::setw(18) << "single file/s" << std::setw(18) << "sharded/s" << std::setw(10) << "speedup\n";
+
+    for (unsigned threads = 1; threads <= cores; threads *= 2)
+    {
+        // Sharding is chosen before the log, so the sink setLogInfo opens is the one measured
+        log.setSharding(Logging::Log::Sharding::NONE);
+        log.setLogInfo("./bench_logs", "single", "Bench");
+        log.setHeader("BENCH");
+
+        const double single = logged(threads);
+
+        log.setSharding(Logging::Log::Sharding::CORE);
+        log.setLogInfo("./bench_logs", "sharded", "Bench");
+        log.setHeader("BENCH");
+
+        report(threads, single, logged(threads));
+    }
+
+    return 0;
+}
@@ -10,6 +10,49 @@ Logging::Log::RGB Logging::Log::loggerInfoColor = Logging::Log::RGB(128, 128, 12
 Logging::Log::RGB Logging::Log::loggerWarnColor = Logging::Log::RGB(255, 165, 0, "loggerWarnColor");
 Logging::Log::RGB Logging::Log::loggerFatalColor = Logging::Log::RGB(255, 0, 0, "loggerFatalColor");
 Logging::Log::RGB Logging::Log::loggerTestSuccessColor = Logging::Log::RGB(25, 207, 73, "loggerTestSuccessColor");
+std::timed_mutex Logging::Log::outputMutex;
+std::atomic<bool> Logging::Log::fatalInProgress = false;
+std::atomic<int> Logging::Log::activeProducers = 0;
+bool Logging::Log::documentFinalized = false;
+Logging::Log::FatalAction Logging::Log::fatalAction = Logging::Log::FatalAction::QUICK_EXIT;
+std::chrono::milliseconds Logging::Log::fatalFlushDeadline = std::chrono::milliseconds(2000);
+Logging::Log::FileSink Logging::Log::fileSink = Logging::Log::FileSink::STREAM;
+std::unique_ptr<Logging::UringFileSink> Logging::Log::uringSink;
+Logging::Log::Sharding Logging::Log::sharding = Logging::Log::Sharding::NONE;
+size_t Logging::Log::shardCapacity = 4096;
+std::atomic<std::shared_ptr<Logging::ShardedFileSink>> Logging::Log::shardedSink;
+int Logging::Log::indexBucketSeconds = 0;
+std::unique_ptr<Logging::LogIndex> Logging::Log::fileIndex;
+uint64_t Logging::Log::fileBytes = 0;
+std::mutex Logging::Log::queueMutex;
+std::condition_variable Logging::Log::queueReady;
+std::condition_variable Logging::Log::queueDrained;
+std::deque<Logging::Log::PendingRecord> Logging::Log::pendingRecords;
+std::deque<Logging::Log::SuspendedRecord> Logging::Log::suspendedRecords;
+std::vector<Logging::Log::SuspendedFlush> Logging::Log::suspendedFlushes;
+size_t Logging::Log::queueCapacity = 0;
+Logging::Log::Backpressure Logging::Log::backpressure = Logging::Log::Backpressure::SUSPEND;
+uint64_t Logging::Log::enqueuedRecords = 0;
+uint64_t Logging::Log::writtenRecords = 0;
+uint64_t Logging::Log::droppedRecords = 0;
+bool Logging::Log::stopWorker = false;
+std::thread Logging::Log::asyncWorker;
+std::function<void(std::coroutine_handle<>)> Logging::Log::asyncResumer = [](std::coroutine_handle<> handle)
+{ handle.resume(); };
+std::mutex Logging::Log::samplingMutex;
+std::unordered_map<std::string, std::unique_ptr<Logging::Log::Sampler>> Logging::Log::headerSamplers;
+std::atomic<size_t> Logging::Log::headerSamplerCount = 0;
+bool Logging::Log::adaptiveVerbosity = false;
+double Logging::Log::adaptiveQueueFill = 0.75;
+std::chrono::microseconds Logging::Log::adaptiveWriteLatency = std::chrono::microseconds(500);
+Logging::Log::Level Logging::Log::adaptiveKeepLevel = Logging::Log::Level::WARN;
+uint32_t Logging::Log::adaptiveMaxRate = 64;
+std::atomic<uint32_t> Logging::Log::adaptiveRate = 1;
+std::atomic<uint64_t> Logging::Log::adaptiveCounter = 0;
+std::atomic<int64_t> Logging::Log::nextPressureCheck = 0;
+std::atomic<int64_t> Logging::Log::writeLatencyTotal = 0;
+std::atomic<int64_t> Logging::Log::writeLatencyCount = 0;
+const std::chrono::milliseconds Logging::Log::pressureCheckInterval = std::chrono::milliseconds(100);
 
 std::string Logging::Log::RGB::toString() const
 {
@@ -38,16 +81,16 @@ void Logging::Log::setHeader(const std::string &logHeader)
 
     if (logLocation != "")
     {
-        outFile.open(logLocation, std::ios::app);
+        std::ostringstream section;
 
         if (headerSet)
-            outStream(outFile, "\\end{flushleft}\n\n");
+            outStream(section, "\\end{flushleft}\n\n");
 
-        outStream(outFile, "\\section{" + header + "}\n\n");
+        outStream(section, "\\section{" + header + "}\n\n");
 
-        outStream(outFile, "\\begin{flushleft}\n\n");
+        outStream(section, "\\begin{flushleft}\n\n");
 
-        outFile.close();
+        emit(PendingRecord(true, section.str()));
     }
 
     headerSet = true;
@@ -60,6 +103,20 @@ void Logging::Log::setLogInfo(const std::string &folder, const std::string &file
 
     author = fileAuthor;
 
+    bool segmentsKept = false;
+
+    // Everything bound for the current log lands there before the new one is truncated, which may be the same file
+    flush();
+
+    {
+        std::lock_guard<std::timed_mutex> lock(outputMutex);
+
+        segmentsKept = !closeFileSink();
+    }
+
+    if (segmentsKept)
+        LG_WARN("Unable to fold the segments of {0} back into it, they are left for logmerge", true, logLocation.string());
+
     if (!std::regex_match(folder, logFolderLocationRegex))
     {
         LG_WARN("{0} is an invalid folder location. The folder location will default to './logs'", true, folder);
@@ -88,23 +145,848 @@ void Logging::Log::setLogInfo(const std::string &folder, const std::string &file
     outFile.open(logLocation);
     outFile.close();
 
+    // An index left from an earlier run describes records that are gone, and a fold would resume it
+    LogIndex::removeFiles(logLocation);
+
+    documentFinalized = false;
+    headerSet = false;
+
+    openFileSink();
+
     initializeFile();
 }
 
-Logging::Log::DecimalFormat::DecimalFormat(std::string &formatting) : formatter(formatting)
+void Logging::Log::setFatalHandling(const FatalAction action, const std::chrono::milliseconds flushDeadline)
+{
+    fatalAction = action;
+    fatalFlushDeadline = flushDeadline;
+}
+
+void Logging::Log::setFileSink(const FileSink sink)
+{
+    fileSink = sink;
+
+    if (logLocation != "")
+        openFileSink();
+}
+
+void Logging::Log::setSharding(const Sharding mode, const size_t capacityPerShard)
+{
+    sharding = mode;
+    shardCapacity = capacityPerShard;
+
+    if (logLocation != "")
+        openFileSink();
+}
+
+void Logging::Log::setIndexing(const bool enabled, const int bucketSeconds)
+{
+    indexBucketSeconds = enabled ? std::max(bucketSeconds, 1) : 0;
+
+    if (logLocation != "")
+        openFileSink();
+}
+
+void Logging::Log::setAsyncQueue(const size_t capacity, const Backpressure policy)
+{
+    stopAsyncWorker();
+
+    queueCapacity = capacity;
+    backpressure = policy;
+
+    if (queueCapacity > 0)
+        asyncWorker = std::thread(drainQueue);
+}
+
+void Logging::Log::setAsyncResumer(const std::function<void(std::coroutine_handle<>)> &resumer)
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+
+    asyncResumer = resumer;
+}
+
+void Logging::Log::setSampling(const std::string &category, const SampleMode mode, const uint32_t oneIn)
+{
+    std::lock_guard<std::mutex> lock(samplingMutex);
+
+    if (oneIn <= 1)
+        headerSamplers.erase(category);
+    else
+        headerSamplers[category] = std::make_unique<Sampler>(mode, oneIn);
+
+    headerSamplerCount = headerSamplers.size();
+}
+
+void Logging::Log::setAdaptiveVerbosity(const bool enabled, const double queueFill, const std::chrono::microseconds writeLatency, const Level keepLevel, const uint32_t maxRate)
+{
+    adaptiveVerbosity = enabled;
+    adaptiveQueueFill = queueFill;
+    adaptiveWriteLatency = writeLatency;
+    adaptiveKeepLevel = keepLevel;
+
+    // Bounded so doubling the rate cannot overflow
+    adaptiveMaxRate = std::clamp(maxRate, 1u, 1u << 16);
+
+    adaptiveRate = 1;
+    writeLatencyTotal = 0;
+    writeLatencyCount = 0;
+}
+
+uint32_t Logging::Log::getAdaptiveRate()
+{
+    return adaptiveRate;
+}
+
+uint64_t Logging::Log::getDroppedRecords()
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+
+    return droppedRecords;
+}
+
+void Logging::Log::flush()
+{
+    if (asyncWorker.joinable() && std::this_thread::get_id() != asyncWorker.get_id())
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+
+        const uint64_t target = enqueuedRecords;
+
+        queueDrained.wait(lock, [target]()
+                          { return writtenRecords >= target; });
+    }
+
+    // Released before the output lock, which folding holds while it waits for the last reference
+    if (const std::shared_ptr<ShardedFileSink> sink = shardedSink.load())
+        sink->flush();
+
+    std::lock_guard<std::timed_mutex> lock(outputMutex);
+
+    if (uringSink)
+        uringSink->flush();
+
+    saveIndex();
+
+    std::cout.flush();
+}
+
+bool Logging::Log::RecordAwaitable::await_ready()
+{
+    if (skip)
+        return true;
+
+    // File records on a sharded sink skip the shared queue unless their shard is full
+    if (record.toFile && !fatalInProgress)
+        if (const std::shared_ptr<ShardedFileSink> sink = shardedSink.load(); sink && sink->write(record.text, record.meta, false))
+            return true;
+
+    if (queueCapacity == 0)
+    {
+        emit(std::move(record));
+
+        return true;
+    }
+
+    return enqueue(record, false);
+}
+
+bool Logging::Log::RecordAwaitable::await_suspend(std::coroutine_handle<> handle)
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+
+    // Space may have been freed since await_ready
+    if (pendingRecords.size() < queueCapacity && suspendedRecords.empty())
+    {
+        pendingRecords.push_back(std::move(record));
+        enqueuedRecords++;
+
+        lock.unlock();
+        queueReady.notify_one();
+
+        return false;
+    }
+
+    suspendedRecords.push_back({std::move(record), handle});
+
+    return true;
+}
+
+bool Logging::Log::FlushAwaitable::await_ready()
+{
+    if (!asyncWorker.joinable())
+    {
+        flush();
+
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(queueMutex);
+
+    target = enqueuedRecords + suspendedRecords.size();
+
+    return false;
+}
+
+bool Logging::Log::FlushAwaitable::await_suspend(std::coroutine_handle<> handle)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+
+        suspendedFlushes.push_back({target, handle});
+    }
+
+    queueReady.notify_one();
+
+    return true;
+}
+
+bool Logging::Log::enqueue(PendingRecord &record, const bool block)
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+
+    if (pendingRecords.size() >= queueCapacity || !suspendedRecords.empty())
+    {
+        if (backpressure == Backpressure::DROP && record.droppable)
+        {
+            droppedRecords++;
+
+            return true;
+        }
+
+        if (!block)
+            return false;
+
+        // A coroutine resumed on the worker cannot wait for the worker to make room
+        if (std::this_thread::get_id() == asyncWorker.get_id())
+        {
+            lock.unlock();
+
+            std::lock_guard<std::timed_mutex> output(outputMutex);
+
+            writeOutput(record);
+
+            return true;
+        }
+
+        queueDrained.wait(lock, []()
+                          { return pendingRecords.size() < queueCapacity; });
+    }
+
+    pendingRecords.push_back(std::move(record));
+    enqueuedRecords++;
+
+    lock.unlock();
+    queueReady.notify_one();
+
+    return true;
+}
+
+void Logging::Log::drainQueue()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+
+    while (true)
+    {
+        queueReady.wait(lock, []()
+                        { return !pendingRecords.empty() || !suspendedFlushes.empty() || stopWorker; });
+
+        if (pendingRecords.empty() && suspendedRecords.empty() && suspendedFlushes.empty() && stopWorker)
+            break;
+
+        std::deque<PendingRecord> batch;
+
+        batch.swap(pendingRecords);
+
+        // Suspended coroutines get their records in first, in the order they suspended
+        std::vector<std::coroutine_handle<>> resumable;
+
+        while (!suspendedRecords.empty() && pendingRecords.size() < queueCapacity)
+        {
+            pendingRecords.push_back(std::move(suspendedRecords.front().record));
+            enqueuedRecords++;
+
+            resumable.push_back(suspendedRecords.front().handle);
+            suspendedRecords.pop_front();
+        }
+
+        lock.unlock();
+        queueDrained.notify_all();
+
+        {
+            std::lock_guard<std::timed_mutex> output(outputMutex);
+
+            for (const PendingRecord &record : batch)
+                writeOutput(record);
+        }
+
+        lock.lock();
+
+        writtenRecords += batch.size();
+
+        std::vector<SuspendedFlush> flushed;
+
+        for (size_t i = 0; i < suspendedFlushes.size();)
+        {
+            if (suspendedFlushes[i].target <= writtenRecords)
+            {
+                flushed.push_back(suspendedFlushes[i]);
+                suspendedFlushes.erase(suspendedFlushes.begin() + static_cast<long>(i));
+            }
+            else
+                i++;
+        }
+
+        const std::function<void(std::coroutine_handle<>)> resumer = asyncResumer;
+
+        lock.unlock();
+        queueDrained.notify_all();
+
+        if (!flushed.empty())
+        {
+            if (const std::shared_ptr<ShardedFileSink> sink = shardedSink.load())
+                sink->flush();
+
+            std::lock_guard<std::timed_mutex> output(outputMutex);
+
+            if (uringSink)
+                uringSink->flush();
+
+            saveIndex();
+
+            std::cout.flush();
+        }
+
+        // The process is going away, suspended coroutines stay suspended
+        if (!fatalInProgress)
+        {
+            for (std::coroutine_handle<> handle : resumable)
+                resumer(handle);
+
+            for (const SuspendedFlush &suspended : flushed)
+                resumer(suspended.handle);
+        }
+
+        lock.lock();
+    }
+}
+
+void Logging::Log::stopAsyncWorker()
+{
+    if (!asyncWorker.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+
+        stopWorker = true;
+    }
+
+    queueReady.notify_one();
+
+    asyncWorker.join();
+
+    stopWorker = false;
+}
+
+bool Logging::Log::queueEmpty()
+{
+    return writtenRecords == enqueuedRecords && suspendedRecords.empty();
+}
+
+Logging::Log::Sampler::Sampler(const SampleMode sampleMode, const uint32_t oneIn) : mode(sampleMode), rate(oneIn < 1 ? 1 : oneIn), counter(0) {}
+
+bool Logging::Log::Sampler::keep()
+{
+    if (rate == 1)
+        return true;
+
+    if (mode == SampleMode::EVERY)
+        return counter.fetch_add(1, std::memory_order_relaxed) % rate == 0;
+
+    thread_local std::minstd_rand generator(std::random_device{}());
+
+    return std::uniform_int_distribution<uint32_t>(0, rate - 1)(generator) == 0;
+}
+
+uint32_t Logging::Log::Sampler::getRate() const
+{
+    return rate;
+}
+
+bool Logging::Log::admit(const Level level, uint64_t &sampleRate)
+{
+    // Fatal records are never sampled
+    if (level == Level::FATAL)
+        return true;
+
+    // Checked first so records only take the lock while some header is sampled
+    if (headerSamplerCount > 0)
+    {
+        std::lock_guard<std::mutex> lock(samplingMutex);
+
+        std::unordered_map<std::string, std::unique_ptr<Sampler>>::iterator found = headerSamplers.find(header);
+
+        if (found != headerSamplers.end())
+        {
+            if (!found->second->keep())
+                return false;
+
+            sampleRate *= found->second->getRate();
+        }
+    }
+
+    if (!adaptiveVerbosity || level >= adaptiveKeepLevel)
+        return true;
+
+    checkPressure();
+
+    const uint32_t rate = adaptiveRate;
+
+    if (rate > 1)
+    {
+        if (adaptiveCounter.fetch_add(1, std::memory_order_relaxed) % rate != 0)
+            return false;
+
+        sampleRate *= rate;
+    }
+
+    return true;
+}
+
+void Logging::Log::checkPressure()
 {
-    std::regex decimalRegex("^0?.\\d*f$");
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    int64_t next = nextPressureCheck;
+
+    // One producer per interval takes the measurements
+    if (now < next || !nextPressureCheck.compare_exchange_strong(next, now + std::chrono::duration_cast<std::chrono::nanoseconds>(pressureCheckInterval).count()))
+        return;
+
+    double fill = 0;
+
+    if (asyncWorker.joinable() && queueCapacity > 0)
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+
+        fill = static_cast<double>(pendingRecords.size() + suspendedRecords.size()) / static_cast<double>(queueCapacity);
+    }
 
-    if (std::regex_match(formatter, decimalRegex))
+    int64_t writes = writeLatencyCount.exchange(0);
+    int64_t total = writeLatencyTotal.exchange(0);
+
+    // Sharded file records skip the async queue and writeOutput, their shards report both instead
+    if (const std::shared_ptr<ShardedFileSink> sink = shardedSink.load())
     {
-        formatter.pop_back();
+        int64_t shardTotal = 0;
+        int64_t shardWrites = 0;
 
-        format = true;
+        sink->takeWriteLatency(shardTotal, shardWrites);
 
-        decimalPrecision = static_cast<int>(std::stof(formatting) * 10);
+        fill = std::max(fill, sink->getQueueFill());
+        total += shardTotal;
+        writes += shardWrites;
     }
+
+    const int64_t latency = writes > 0 ? total / writes : 0;
+    const int64_t threshold = std::chrono::duration_cast<std::chrono::nanoseconds>(adaptiveWriteLatency).count();
+
+    const bool queueHigh = adaptiveQueueFill > 0 && fill >= adaptiveQueueFill;
+    const bool latencyHigh = threshold > 0 && latency >= threshold;
+
+    const bool queueLow = adaptiveQueueFill <= 0 || fill < adaptiveQueueFill / 2;
+    const bool latencyLow = threshold <= 0 || latency < threshold / 2;
+
+    const uint32_t rate = adaptiveRate;
+
+    if (queueHigh || latencyHigh)
+        adaptiveRate = std::min(rate * 2, adaptiveMaxRate);
+    else if (queueLow && latencyLow)
+        adaptiveRate = std::max(rate / 2, 1u);
+}
+
+void Logging::Log::openFileSink()
+{
+    bool uringUnavailable = false;
+    bool segmentsKept = false;
+
+    {
+        std::lock_guard<std::timed_mutex> lock(outputMutex);
+
+        segmentsKept = !closeFileSink();
+
+        fileBytes = std::filesystem::exists(logLocation) ? std::filesystem::file_size(logLocation) : 0;
+
+        if (indexBucketSeconds > 0 && sharding == Sharding::NONE)
+            fileIndex = std::make_unique<LogIndex>(logLocation, indexBucketSeconds, fileBytes);
+
+        if (sharding != Sharding::NONE)
+        {
+            const std::shared_ptr<ShardedFileSink> sink = std::make_shared<ShardedFileSink>(logLocation, sharding == Sharding::CORE ? ShardedFileSink::Granularity::CORE : ShardedFileSink::Granularity::NUMA_NODE, shardCapacity, fileSink == FileSink::URING, indexBucketSeconds);
+
+            uringUnavailable = fileSink == FileSink::URING && !sink->usingUringSinks();
+
+            shardedSink.store(sink);
+        }
+        else if (fileSink == FileSink::URING)
+        {
+            uringSink = std::make_unique<UringFileSink>(logLocation);
+
+            // Records then take the stream path in writeOutput
+            if (!uringSink->isOpen())
+            {
+                uringSink.reset();
+
+                uringUnavailable = true;
+            }
+        }
+    }
+
+    // Warned once the output lock is released, the warning itself is written under it
+    if (segmentsKept)
+        LG_WARN("Unable to fold the segments of {0} back into it, they are left for logmerge", true, logLocation.string());
+
+    if (uringUnavailable)
+        LG_WARN("Unable to open {0} for the io_uring sink, writing it through a stream instead", true, logLocation.string());
+}
+
+// Flushes and drops the sinks and index of the current log, false when its segments could not be folded back.
+// Called with the output lock held
+bool Logging::Log::closeFileSink()
+{
+    uringSink.reset();
+    fileIndex.reset();
+
+    return foldSegments();
+}
+
+// Drains a sharded sink that is being dropped and appends its records to the log, so a new sink cannot truncate
+// segments nobody merged. Called with the output lock held
+bool Logging::Log::foldSegments()
+{
+    std::shared_ptr<ShardedFileSink> sink = shardedSink.exchange(nullptr);
+
+    if (!sink)
+        return true;
+
+    // Producers that loaded the sink before it was swapped out finish their writes, then dropping it drains them all
+    while (sink.use_count() > 1)
+        std::this_thread::yield();
+
+    sink.reset();
+
+    const uint64_t logBytes = std::filesystem::exists(logLocation) ? std::filesystem::file_size(logLocation) : 0;
+
+    const int64_t bucketSeconds = ShardedFileSink::segmentIndexSeconds(logLocation);
+
+    std::unique_ptr<LogIndex> index;
+
+    if (bucketSeconds > 0)
+        index = std::make_unique<LogIndex>(logLocation, bucketSeconds, logBytes);
+
+    size_t segments = 0;
+    size_t records = 0;
+
+    outFile.open(logLocation, std::ios::app | std::ios::binary);
+
+    const bool merged = ShardedFileSink::mergeSegments(logLocation, outFile, logBytes, index.get(), segments, records);
+
+    outFile.close();
+
+    if (merged)
+        ShardedFileSink::removeSegments(logLocation);
+
+    return merged;
+}
+
+// Kept out of line, the implicit versions are too large for -Winline wherever a record is handed off
+Logging::Log::PendingRecord::PendingRecord(const bool file, std::string &&output, RecordMeta &&recordMeta, const bool mayDrop) : toFile(file), text(std::move(output)), meta(std::move(recordMeta)), droppable(mayDrop) {}
+
+Logging::Log::PendingRecord::PendingRecord(PendingRecord &&other) noexcept = default;
+
+Logging::Log::PendingRecord::~PendingRecord() = default;
+
+Logging::Log::PendingRecord &Logging::Log::PendingRecord::operator=(PendingRecord &&other) noexcept = default;
+
+Logging::Log::PendingRecord Logging::Log::finishRecord(Record &record)
+{
+    RecordMeta meta;
+
+    meta.indexed = record.toFile;
+    meta.time = record.time;
+    meta.level = static_cast<uint32_t>(record.level);
+    meta.section = header;
+
+    // Taken here so a record that waits in the async queue still merges in the order it was logged
+    meta.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+
+    return PendingRecord(record.toFile, record.stream.str(), std::move(meta), record.level != Level::FATAL);
+}
+
+void Logging::Log::emit(PendingRecord &&record)
+{
+    // Announce the record before checking the flag so a fatal shutdown either sees it or stops it
+    activeProducers++;
+
+    std::shared_ptr<ShardedFileSink> sink = !fatalInProgress && record.toFile ? shardedSink.load() : nullptr;
+
+    if (sink)
+    {
+        sink->write(record.text, record.meta);
+
+        sink.reset();
+    }
+    else if (!fatalInProgress && asyncWorker.joinable())
+        enqueue(record, true);
+    else if (!fatalInProgress)
+    {
+        std::lock_guard<std::timed_mutex> lock(outputMutex);
+
+        writeOutput(record);
+    }
+
+    activeProducers--;
+}
+
+void Logging::Log::writeOutput(const PendingRecord &record)
+{
+    if (const std::shared_ptr<ShardedFileSink> sink = record.toFile ? shardedSink.load() : nullptr)
+    {
+        sink->write(record.text, record.meta);
+
+        return;
+    }
+
+    // Sink latency is only measured when adaptive verbosity reads it
+    const std::chrono::steady_clock::time_point start = adaptiveVerbosity ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+    if (!record.toFile)
+        outStream(std::cout, record.text);
+    else
+    {
+        if (fileIndex && record.meta.indexed)
+            fileIndex->add(fileBytes, record.text.length(), record.meta);
+
+        fileBytes += record.text.length();
+
+        if (uringSink)
+            uringSink->write(record.text);
+        else
+        {
+            outFile.open(logLocation, std::ios::app);
+
+            outStream(outFile, record.text);
+
+            outFile.close();
+        }
+    }
+
+    if (adaptiveVerbosity)
+    {
+        writeLatencyTotal += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        writeLatencyCount++;
+    }
+}
+
+void Logging::Log::saveIndex()
+{
+    if (fileIndex)
+        fileIndex->save();
+}
+
+void Logging::Log::finalizeDocument()
+{
+    if (logLocation == "" || documentFinalized)
+        return;
+
+    std::string closing = headerSet ? "\\end{flushleft}" : "";
+
+    closing += "\\end{document}";
+
+    if (fatalInProgress)
+        writeOutput(PendingRecord(true, std::move(closing)));
     else
-        format = false;
+        emit(PendingRecord(true, std::move(closing)));
+
+    documentFinalized = true;
+
+    const std::shared_ptr<ShardedFileSink> sink = fatalInProgress ? shardedSink.load() : nullptr;
+
+    if (sink)
+        sink->flush();
+    else if (fatalInProgress && uringSink)
+        uringSink->flush();
+
+    if (fatalInProgress)
+    {
+        saveIndex();
+
+        return;
+    }
+
+    flush();
+
+    bool segmentsKept = false;
+
+    // A finished sharded log becomes the single ordered document, logmerge is only needed after a fatal or a crash
+    {
+        std::lock_guard<std::timed_mutex> lock(outputMutex);
+
+        segmentsKept = !foldSegments();
+    }
+
+    if (segmentsKept)
+        LG_WARN("Unable to fold the segments of {0} back into it, they are left for logmerge", true, logLocation.string());
+}
+
+void Logging::Log::shutdownAfterFatal(PendingRecord &&record)
+{
+    // Only the first fatal caller shuts down, any other thread waits for the process to end
+    if (fatalInProgress.exchange(true))
+        while (true)
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + fatalFlushDeadline;
+
+    // Stay bounded in time even if a sink never returns
+    std::thread([deadline]()
+                {
+                    std::this_thread::sleep_until(deadline);
+
+                    terminateProcess(false); })
+        .detach();
+
+    while (activeProducers > 0 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+
+    std::deque<PendingRecord> remaining;
+
+    if (asyncWorker.joinable() && std::this_thread::get_id() != asyncWorker.get_id())
+    {
+        std::unique_lock<std::mutex> queueLock(queueMutex);
+
+        queueDrained.wait_until(queueLock, deadline, queueEmpty);
+    }
+    else if (asyncWorker.joinable())
+    {
+        // Fatal on the worker, e.g. from a coroutine it resumed, so nothing else drains the queue
+        std::lock_guard<std::mutex> queueLock(queueMutex);
+
+        remaining.swap(pendingRecords);
+
+        for (SuspendedRecord &suspended : suspendedRecords)
+            remaining.push_back(std::move(suspended.record));
+
+        suspendedRecords.clear();
+    }
+
+    if (const std::shared_ptr<ShardedFileSink> sink = shardedSink.load())
+        sink->waitUntilDrained(deadline);
+
+    std::unique_lock<std::timed_mutex> lock(outputMutex, deadline);
+
+    if (lock.owns_lock())
+    {
+        // The watchdog still ends the process at the deadline if these take too long
+        for (const PendingRecord &queued : remaining)
+            writeOutput(queued);
+
+        writeOutput(record);
+
+        finalizeDocument();
+    }
+
+    terminateProcess(true);
+}
+
+void Logging::Log::terminateProcess(const bool graceful)
+{
+    if (fatalAction == FatalAction::ABORT)
+        std::abort();
+
+    if (graceful)
+    {
+        std::cout.flush();
+
+        std::quick_exit(1);
+    }
+
+    std::_Exit(1);
+}
+
+Logging::Log::DecimalFormat::DecimalFormat(const std::string &formatting) : decimalPrecision(-1), mode(std::chars_format::general), grouping(false), format(false)
+{
+    size_t i = 0;
+
+    if (i < formatting.length() && formatting[i] == ',')
+    {
+        grouping = true;
+        i++;
+    }
+
+    // A lone "," groups the shortest fixed form
+    if (i == formatting.length())
+    {
+        mode = std::chars_format::fixed;
+        format = grouping;
+
+        return;
+    }
+
+    if (formatting[i] == '0')
+        i++;
+
+    if (i >= formatting.length() || formatting[i++] != '.')
+    {
+        grouping = false;
+
+        return;
+    }
+
+    const size_t digits = i;
+
+    int precision = 0;
+
+    for (; i < formatting.length() && std::isdigit(static_cast<unsigned char>(formatting[i])); i++)
+    {
+        // A precision that does not fit an int is not a spec
+        if (precision > (std::numeric_limits<int>::max() - 9) / 10)
+        {
+            grouping = false;
+
+            return;
+        }
+
+        precision = precision * 10 + (formatting[i] - '0');
+    }
+
+    if (i + 1 != formatting.length())
+    {
+        grouping = false;
+
+        return;
+    }
+
+    switch (formatting[i])
+    {
+    case 'f':
+        mode = std::chars_format::fixed;
+        break;
+    case 'e':
+        mode = std::chars_format::scientific;
+        break;
+    case 'g':
+        mode = std::chars_format::general;
+        break;
+    default:
+        grouping = false;
+
+        return;
+    }
+
+    decimalPrecision = i > digits ? precision : -1;
+
+    format = true;
 }
 
 int Logging::Log::DecimalFormat::getPrecision() const
@@ -117,6 +999,20 @@ bool Logging::Log::DecimalFormat::getFormat() const
     return format;
 }
 
+void Logging::Log::DecimalFormat::group(std::string &number)
+{
+    const size_t start = !number.empty() && number[0] == '-' ? 1 : 0;
+
+    size_t end = start;
+
+    while (end < number.length() && std::isdigit(static_cast<unsigned char>(number[end])))
+        end++;
+
+    // Only the integer digits are grouped, the fraction and any exponent are left alone
+    for (size_t i = end; i > start + 3; i -= 3)
+        number.insert(i - 3, 1, ',');
+}
+
 Logging::Log::Alignment::Alignment(const std::string &format) : formatter(format)
 {
     std::regex leftAligned("^<\\d+$"), rightAligned("^>\\d+$"), centerAligned("^=\\d+$");
@@ -9,6 +9,29 @@
 #include <iomanip>
 #include <fstream>
 #include <filesystem>
+#include <cstring>
+#include <cstdlib>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <coroutine>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <random>
+#include <charconv>
+#include <cmath>
+#include <cctype>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#include "uringsink.h"
+#include "shardsink.h"
+#include "logindex.h"
 
 #define LG_INFO(...) Logging::Log::info(__VA_ARGS__)
 #define LG_WARN(...) Logging::Log::warn(__VA_ARGS__)
@@ -16,26 +39,81 @@
 #define LG_TEST_SUCCESS(...) Logging::Log::testSuccess(__VA_ARGS__)
 #define LG_TEST_FAIL(...) Logging::Log::testFailure(__VA_ARGS__)
 
+// Call site sampling, each expansion keeps one record in n with its own sampler
+#define LG_INFO_EVERY(n, ...) LG_SAMPLED(info, Logging::Log::SampleMode::EVERY, n, __VA_ARGS__)
+#define LG_INFO_SAMPLED(n, ...) LG_SAMPLED(info, Logging::Log::SampleMode::PROBABILITY, n, __VA_ARGS__)
+#define LG_WARN_EVERY(n, ...) LG_SAMPLED(warn, Logging::Log::SampleMode::EVERY, n, __VA_ARGS__)
+#define LG_WARN_SAMPLED(n, ...) LG_SAMPLED(warn, Logging::Log::SampleMode::PROBABILITY, n, __VA_ARGS__)
+
+#define LG_SAMPLED(call, mode, n, ...)                       \
+    do                                                       \
+    {                                                        \
+        static Logging::Log::Sampler lgSampler((mode), (n)); \
+        lgSampler.call(__VA_ARGS__);                         \
+    } while (false)
+
 namespace Logging
 {
 
     class Log
     {
+        // Number spec, [,][0].[digits](f|e|g) or a lone "," for grouping only. Without digits the value is printed
+        // in the shortest form that reads back to the same value. Unformatted floats keep std::to_string's 0.6f.
         class DecimalFormat
         {
         public:
-            DecimalFormat() : format(false) {}
+            DecimalFormat() : decimalPrecision(-1), mode(std::chars_format::general), grouping(false), format(false) {}
 
-            DecimalFormat(std::string &formatting);
+            DecimalFormat(const std::string &formatting);
 
             int getPrecision() const;
 
             bool getFormat() const;
 
+            template <typename T>
+            std::string apply(const T value) const
+            {
+                std::string output;
+
+                if constexpr (std::is_floating_point_v<T>)
+                {
+                    // Any T is exact within this many decimals, every digit asked for past them is a zero
+                    const int exact = std::numeric_limits<T>::digits - std::numeric_limits<T>::min_exponent;
+                    const int precision = std::min(decimalPrecision, exact);
+
+                    // Fixed notation can need every digit of the largest exponent before the point
+                    output.resize(static_cast<size_t>(std::numeric_limits<T>::max_exponent10 + std::numeric_limits<T>::max_digits10 + std::max(precision, 0) + 8));
+
+                    std::to_chars_result result = precision < 0 ? std::to_chars(output.data(), output.data() + output.size(), value, mode) : std::to_chars(output.data(), output.data() + output.size(), value, mode, precision);
+
+                    output.resize(static_cast<size_t>(result.ptr - output.data()));
+
+                    // General notation drops trailing zeros anyway
+                    if (decimalPrecision > exact && mode != std::chars_format::general && std::isfinite(value))
+                        output.insert(mode == std::chars_format::scientific ? output.find('e') : output.length(), static_cast<size_t>(decimalPrecision - exact), '0');
+                }
+                else
+                {
+                    char digits[std::numeric_limits<T>::digits10 + 3];
+
+                    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+
+                    output.assign(digits, result.ptr);
+                }
+
+                if (grouping)
+                    group(output);
+
+                return output;
+            }
+
         private:
             int decimalPrecision;
-            std::string formatter;
+            std::chars_format mode;
+            bool grouping;
             bool format;
+
+            static void group(std::string &number);
         };
 
         class Alignment
@@ -100,20 +178,53 @@ namespace Logging
         };
 
     public:
-        ~Log()
+        enum FatalAction
         {
-            if (logLocation != "")
-            {
-                outFile.open(logLocation, std::ios::app);
+            QUICK_EXIT,
+            ABORT
+        };
 
-                if (headerSet)
-                    outStream(outFile, "\\end{flushleft}");
+        enum FileSink
+        {
+            STREAM,
+            URING
+        };
 
-                outStream(outFile, "\\end{document}");
+        enum Sharding
+        {
+            NONE,
+            CORE,
+            NUMA
+        };
 
-                outFile.close();
-            }
+        enum Level
+        {
+            INFO,
+            TEST_SUCCESS,
+            WARN,
+            TEST_FAILURE,
+            FATAL
+        };
+
+        enum Backpressure
+        {
+            SUSPEND,
+            DROP
+        };
+
+        enum SampleMode
+        {
+            EVERY,
+            PROBABILITY
+        };
+
+        ~Log()
+        {
+            finalizeDocument();
+
+            stopAsyncWorker();
         }
+
         struct RGB
         {
             short red, green, blue;
@@ -126,68 +237,228 @@ namespace Logging
         template <class... Args>
         static void info(const std::string &logMessage, const bool ignoreFile = false, const Args &...args)
         {
-            loggerAbstraction(loggerInfoColor, logMessage, ignoreFile, args...);
+            loggerAbstraction(Level::INFO, loggerInfoColor, logMessage, ignoreFile, 1, args...);
         }
 
         template <class... Args>
         static void warn(const std::string &logMessage, const bool ignoreFile = false, const Args &...args)
         {
-            loggerAbstraction(loggerWarnColor, logMessage, ignoreFile, args...);
+            loggerAbstraction(Level::WARN, loggerWarnColor, logMessage, ignoreFile, 1, args...);
         }
 
         template <class... Args>
-        static void fatal(const std::string &logMessage, const bool ignoreFile = false, const Args &...args)
+        [[noreturn]] static void fatal(const std::string &logMessage, const bool ignoreFile = false, const Args &...args)
         {
-            loggerAbstraction(loggerFatalColor, logMessage, ignoreFile, args...);
+            Record record(logLocation != "" && !ignoreFile, Level::FATAL);
+
+            formatRecord(record, loggerFatalColor, logMessage, args...);
 
-            exit(1);
+            // Handed to the shutdown rather than emitted, so no sink is touched before the deadline is running
+            shutdownAfterFatal(finishRecord(record));
         }
 
         template <class... Args>
         static void testSuccess(const std::string &logMessage, const bool ignoreFile = false, const Args &...args)
         {
-            loggerAbstraction(loggerTestSuccessColor, logMessage, ignoreFile, args...);
+            loggerAbstraction(Level::TEST_SUCCESS, loggerTestSuccessColor, logMessage, ignoreFile, 1, args...);
         }
 
         template <class... Args>
         static void testFailure(const std::string &logMessage, const bool ignoreFile = false, const Args &...args)
         {
-            loggerAbstraction(loggerFatalColor, logMessage, ignoreFile, args...);
+            loggerAbstraction(Level::TEST_FAILURE, loggerFatalColor, logMessage, ignoreFile, 1, args...);
+        }
+
+        // Keeps one record in oneIn, either every oneIn-th record or each record with probability 1 / oneIn. Kept
+        // records note the rate so counts can be scaled back up.
+        class Sampler
+        {
+        public:
+            Sampler(const SampleMode sampleMode, const uint32_t oneIn);
+
+            bool keep();
+
+            uint32_t getRate() const;
+
+            template <class... Args>
+            void info(const std::string &logMessage, const bool ignoreFile = false, const Args &...args)
+            {
+                if (keep())
+                    loggerAbstraction(Level::INFO, loggerInfoColor, logMessage, ignoreFile, rate, args...);
+            }
+
+            template <class... Args>
+            void warn(const std::string &logMessage, const bool ignoreFile = false, const Args &...args)
+            {
+                if (keep())
+                    loggerAbstraction(Level::WARN, loggerWarnColor, logMessage, ignoreFile, rate, args...);
+            }
+
+        private:
+            SampleMode mode;
+            uint32_t rate;
+            std::atomic<uint64_t> counter;
+        };
+
+    private:
+        // A single log line, formatted in full before it is handed to a sink
+        struct Record
+        {
+            Record(const bool file, const Level recordLevel) : toFile(file), level(recordLevel), time(0), sampleRate(1) {}
+
+            bool toFile;
+            Level level;
+            time_t time;
+            uint64_t sampleRate;
+            std::ostringstream stream;
+        };
+
+        struct PendingRecord
+        {
+            PendingRecord(const bool file, std::string &&output, RecordMeta &&recordMeta = RecordMeta(), const bool mayDrop = false);
+            PendingRecord(PendingRecord &&other) noexcept;
+            ~PendingRecord();
+
+            PendingRecord &operator=(PendingRecord &&other) noexcept;
+
+            bool toFile;
+            std::string text;
+            RecordMeta meta;
+
+            // Only log records below FATAL, the document structure always reaches the file
+            bool droppable;
+        };
+
+    public:
+        // Enqueues an already formatted record, suspending the awaiting coroutine only while the queue is full. Nothing
+        // is enqueued until it is awaited, so discarding it is a compile error
+        class [[nodiscard]] RecordAwaitable
+        {
+        public:
+            RecordAwaitable(PendingRecord &&pending) : record(std::move(pending)), skip(false) {}
+            RecordAwaitable() : record(false, ""), skip(true) {}
+
+            bool await_ready();
+            bool await_suspend(std::coroutine_handle<> handle);
+            void await_resume() const {}
+
+        private:
+            PendingRecord record;
+            bool skip;
+        };
+
+        // Resumes the awaiting coroutine once every record enqueued before it has reached the sinks
+        class [[nodiscard]] FlushAwaitable
+        {
+        public:
+            FlushAwaitable() : target(0) {}
+
+            bool await_ready();
+            bool await_suspend(std::coroutine_handle<> handle);
+            void await_resume() const {}
+
+        private:
+            uint64_t target;
+        };
+
+        template <class... Args>
+        static RecordAwaitable infoAsync(const std::string &logMessage, const bool ignoreFile = false, const Args &...args)
+        {
+            return formatAsync(Level::INFO, loggerInfoColor, logMessage, ignoreFile, args...);
         }
 
         template <class... Args>
-        static void loggerAbstraction(const RGB &coloredText, const std::string &logMessage, const bool ignoreFile, const Args &...args)
+        static RecordAwaitable warnAsync(const std::string &logMessage, const bool ignoreFile = false, const Args &...args)
         {
+            return formatAsync(Level::WARN, loggerWarnColor, logMessage, ignoreFile, args...);
+        }
+
+        template <class... Args>
+        static RecordAwaitable testSuccessAsync(const std::string &logMessage, const bool ignoreFile = false, const Args &...args)
+        {
+            return formatAsync(Level::TEST_SUCCESS, loggerTestSuccessColor, logMessage, ignoreFile, args...);
+        }
+
+        template <class... Args>
+        static RecordAwaitable testFailureAsync(const std::string &logMessage, const bool ignoreFile = false, const Args &...args)
+        {
+            return formatAsync(Level::TEST_FAILURE, loggerFatalColor, logMessage, ignoreFile, args...);
+        }
+
+        static FlushAwaitable flushAsync()
+        {
+            return FlushAwaitable();
+        }
+
+        template <class... Args>
+        static void loggerAbstraction(const Level level, const RGB &coloredText, const std::string &logMessage, const bool ignoreFile, const uint64_t siteRate, const Args &...args)
+        {
+            // Producers are stopped once a fatal record is being handled
+            if (fatalInProgress)
+                return;
+
+            uint64_t sampleRate = siteRate;
+
+            // Dropped before any formatting is done
+            if (!admit(level, sampleRate))
+                return;
+
+            Record record(logLocation != "" && !ignoreFile, level);
+
+            record.sampleRate = sampleRate;
+
+            formatRecord(record, coloredText, logMessage, args...);
+
+            emit(finishRecord(record));
+        }
+
+        template <class... Args>
+        static RecordAwaitable formatAsync(const Level level, const RGB &coloredText, const std::string &logMessage, const bool ignoreFile, const Args &...args)
+        {
+            uint64_t sampleRate = 1;
+
+            if (fatalInProgress || !admit(level, sampleRate))
+                return RecordAwaitable();
+
+            Record record(logLocation != "" && !ignoreFile, level);
+
+            record.sampleRate = sampleRate;
+
+            formatRecord(record, coloredText, logMessage, args...);
+
+            return RecordAwaitable(finishRecord(record));
+        }
+
+        template <class... Args>
+        static void formatRecord(Record &record, const RGB &coloredText, const std::string &logMessage, const Args &...args)
+        {
+
             std::string newLogMessage = logMessage;
 
             while (newLogMessage[0] == '\n' || newLogMessage[0] == '\t')
             {
                 if (newLogMessage[0] == '\n')
-                    sendOutput("\n", ignoreFile);
+                    sendOutput(record, "\n");
                 else
-                    sendOutput("\t", ignoreFile);
+                    sendOutput(record, "\t");
 
                 newLogMessage.erase(0, 1);
             }
 
-            outFile.open(logLocation, std::ios::app);
-
-            if (headerSet)
-                outStream(outFile, "\\hspace{\\parindent} ");
-
-            outStream(outFile, "\\textcolor{" + coloredText.name + "}{");
-
-            outFile.close();
-
-            sendOutput("[", ignoreFile);
+            if (record.toFile)
+            {
+                if (headerSet)
+                    sendOutput(record, "\\hspace{\\parindent} ");
 
-            printer(newLogMessage, ignoreFile, args...);
+                sendOutput(record, "\\textcolor{" + coloredText.name + "}{");
+            }
 
-            outFile.open(logLocation, std::ios::app);
+            sendOutput(record, "[");
 
-            outStream(outFile, "}\n\n");
+            printer(record, newLogMessage, args...);
 
-            outFile.close();
+            if (record.toFile)
+                sendOutput(record, "}\n\n");
         }
 
         void setTimeFormatting(const std::string &format);
@@ -196,6 +467,54 @@ namespace Logging
 
         void setLogInfo(const std::string &folder, const std::string &file, const std::string &fileAuthor);
 
+        void setFatalHandling(const FatalAction action, const std::chrono::milliseconds flushDeadline);
+
+        void setFileSink(const FileSink sink);
+
+        // Splits the log file into per-core or per-NUMA-node segments, folded back into it when the document is
+        // finalized or the file sink changes. After a fatal or a crash they are merged with logmerge
+        void setSharding(const Sharding mode, const size_t capacityPerShard = 4096);
+
+        // Writes <log>.idx next to each log file so logq can query it, bucketing record times by the given seconds
+        void setIndexing(const bool enabled, const int bucketSeconds = 60);
+
+        // A capacity of 0 keeps logging synchronous, otherwise records are written by a background worker. DROP only
+        // drops log records below FATAL, the preamble, sections and document end still wait for room.
+        void setAsyncQueue(const size_t capacity, const Backpressure policy = Backpressure::SUSPEND);
+
+        // Decides where coroutines suspended by the async calls are resumed, inline on the worker by default
+        void setAsyncResumer(const std::function<void(std::coroutine_handle<>)> &resumer);
+
+        // Samples every record logged under the given header, a rate of 1 logs all of them again
+        void setSampling(const std::string &category, const SampleMode mode, const uint32_t oneIn);
+
+        // Thins records below keepLevel while the async queue, or with sharding the fullest shard queue, is at least
+        // queueFill full or sink writes take at least writeLatency on average. The rate doubles on every check under pressure up to maxRate, and halves back once
+        // both are below half their thresholds. A threshold of 0 leaves that signal out.
+        void setAdaptiveVerbosity(const bool enabled, const double queueFill = 0.75, const std::chrono::microseconds writeLatency = std::chrono::microseconds(500), const Level keepLevel = Level::WARN, const uint32_t maxRate = 64);
+
+        static uint32_t getAdaptiveRate();
+
+        static uint64_t getDroppedRecords();
+
+        static void flush();
+
+        // Formats a number the way a {N:spec} placeholder with that spec would
+        template <typename T>
+        static std::string formatNumber(const T value, const std::string &spec)
+        {
+            const DecimalFormat format(spec);
+
+            if (format.getFormat())
+                return format.apply(value);
+
+            // A placeholder ignores a spec it cannot read, printing floats as 0.6f and integers in full
+            if constexpr (std::is_floating_point_v<T>)
+                return DecimalFormat("0.6f").apply(value);
+            else
+                return DecimalFormat().apply(value);
+        }
+
     private:
         static std::string timeFormatting;
         static std::string header;
@@ -207,6 +526,95 @@ namespace Logging
         static RGB loggerWarnColor;
         static RGB loggerFatalColor;
         static RGB loggerTestSuccessColor;
+        static std::timed_mutex outputMutex;
+        static std::atomic<bool> fatalInProgress;
+        static std::atomic<int> activeProducers;
+        static bool documentFinalized;
+        static FatalAction fatalAction;
+        static std::chrono::milliseconds fatalFlushDeadline;
+        static FileSink fileSink;
+        static std::unique_ptr<UringFileSink> uringSink;
+        static Sharding sharding;
+        static size_t shardCapacity;
+        // Read without the output lock by producers, so it is swapped atomically and kept alive by their copies
+        static std::atomic<std::shared_ptr<ShardedFileSink>> shardedSink;
+        static int indexBucketSeconds;
+        static std::unique_ptr<LogIndex> fileIndex;
+        static uint64_t fileBytes;
+
+        struct SuspendedRecord
+        {
+            PendingRecord record;
+            std::coroutine_handle<> handle;
+        };
+
+        struct SuspendedFlush
+        {
+            uint64_t target;
+            std::coroutine_handle<> handle;
+        };
+
+        static std::mutex queueMutex;
+        static std::condition_variable queueReady;
+        static std::condition_variable queueDrained;
+        static std::deque<PendingRecord> pendingRecords;
+        static std::deque<SuspendedRecord> suspendedRecords;
+        static std::vector<SuspendedFlush> suspendedFlushes;
+        static size_t queueCapacity;
+        static Backpressure backpressure;
+        static uint64_t enqueuedRecords;
+        static uint64_t writtenRecords;
+        static uint64_t droppedRecords;
+        static bool stopWorker;
+        static std::thread asyncWorker;
+        static std::function<void(std::coroutine_handle<>)> asyncResumer;
+
+        static std::mutex samplingMutex;
+        static std::unordered_map<std::string, std::unique_ptr<Sampler>> headerSamplers;
+        static std::atomic<size_t> headerSamplerCount;
+        static bool adaptiveVerbosity;
+        static double adaptiveQueueFill;
+        static std::chrono::microseconds adaptiveWriteLatency;
+        static Level adaptiveKeepLevel;
+        static uint32_t adaptiveMaxRate;
+        static std::atomic<uint32_t> adaptiveRate;
+        static std::atomic<uint64_t> adaptiveCounter;
+        static std::atomic<int64_t> nextPressureCheck;
+        static std::atomic<int64_t> writeLatencyTotal;
+        static std::atomic<int64_t> writeLatencyCount;
+        static const std::chrono::milliseconds pressureCheckInterval;
+
+        static PendingRecord finishRecord(Record &record);
+
+        static void emit(PendingRecord &&record);
+
+        static void writeOutput(const PendingRecord &record);
+
+        static void saveIndex();
+
+        static void finalizeDocument();
+
+        static void openFileSink();
+
+        static bool closeFileSink();
+
+        static bool foldSegments();
+
+        static bool enqueue(PendingRecord &record, const bool block);
+
+        static void drainQueue();
+
+        static void stopAsyncWorker();
+
+        static bool queueEmpty();
+
+        static bool admit(const Level level, uint64_t &sampleRate);
+
+        static void checkPressure();
+
+        [[noreturn]] static void shutdownAfterFatal(PendingRecord &&record);
+
+        [[noreturn]] static void terminateProcess(const bool graceful);
 
         static void setTimeFormat(std::string &timeFormat, const size_t index, const tm *local_time)
         {
@@ -225,51 +633,45 @@ namespace Logging
 
         static void initializeFile()
         {
-            outFile.open(logLocation, std::ios::app);
+            std::ostringstream preamble;
 
-            outStream(outFile, "\\documentclass[12pt, a4paper]{article}\n");
-            outStream(outFile, "\\usepackage{xcolor}\n");
-            outStream(outFile, "\\usepackage[a3paper, total={10in, 8in}]{geometry}\n\n");
+            outStream(preamble, "\\documentclass[12pt, a4paper]{article}\n");
+            outStream(preamble, "\\usepackage{xcolor}\n");
+            outStream(preamble, "\\usepackage[a3paper, total={10in, 8in}]{geometry}\n\n");
 
-            outStream(outFile, "\\title{Logging Results}\n");
-            outStream(outFile, "\\author{" + author + "}\n\n");
+            outStream(preamble, "\\title{Logging Results}\n");
+            outStream(preamble, "\\author{" + author + "}\n\n");
 
-            outStream(outFile, "\\definecolor{loggerInfoColor}{RGB}{" + loggerInfoColor.toString() + "}\n");
-            outStream(outFile, "\\definecolor{loggerWarnColor}{RGB}{" + loggerWarnColor.toString() + "}\n");
-            outStream(outFile, "\\definecolor{loggerFatalColor}{RGB}{" + loggerFatalColor.toString() + "}\n");
-            outStream(outFile, "\\definecolor{loggerTestSuccessColor}{RGB}{" + loggerTestSuccessColor.toString() + "}\n\n");
+            outStream(preamble, "\\definecolor{loggerInfoColor}{RGB}{" + loggerInfoColor.toString() + "}\n");
+            outStream(preamble, "\\definecolor{loggerWarnColor}{RGB}{" + loggerWarnColor.toString() + "}\n");
+            outStream(preamble, "\\definecolor{loggerFatalColor}{RGB}{" + loggerFatalColor.toString() + "}\n");
+            outStream(preamble, "\\definecolor{loggerTestSuccessColor}{RGB}{" + loggerTestSuccessColor.toString() + "}\n\n");
 
-            outStream(outFile, "\\begin{document}\n\n");
-            outStream(outFile, "\\maketitle\n\n");
+            outStream(preamble, "\\begin{document}\n\n");
+            outStream(preamble, "\\maketitle\n\n");
 
-            outFile.close();
+            emit(PendingRecord(true, preamble.str()));
         }
 
         template <typename T>
-        static void sendOutput(const T &output, const bool ignoreFile, const RGB *color = nullptr, const DecimalFormat *decimalFormat = nullptr, const Alignment *alignment = nullptr, const Truncation *truncation = nullptr)
+        static void sendOutput(Record &record, const T &output, const RGB *color = nullptr, const DecimalFormat *decimalFormat = nullptr, const Alignment *alignment = nullptr, const Truncation *truncation = nullptr)
         {
-            if (logLocation != "" && !ignoreFile)
-            {
-                outFile.open(logLocation, std::ios::app);
-
-                outStream(outFile, output, decimalFormat, alignment, truncation);
+            if (color && !record.toFile)
+                outStream(record.stream, getLogColor(*color));
 
-                outFile.close();
-            }
-            else
-            {
-                if (color)
-                    outStream(std::cout, getLogColor(*color));
-
-                outStream(std::cout, output, decimalFormat, alignment, truncation);
-            }
+            outStream(record.stream, output, decimalFormat, alignment, truncation);
         }
 
         template <typename T>
         static void outStream(std::ostream &stream, const T &output, const DecimalFormat *decimalFormat = nullptr, const Alignment *alignment = nullptr, const Truncation *truncation = nullptr)
         {
             if (decimalFormat != nullptr && decimalFormat->getFormat())
-                stream << std::fixed << std::setprecision(decimalFormat->getPrecision()) << output;
+            {
+                if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, char>)
+                    stream << decimalFormat->apply(output);
+                else
+                    stream << output;
+            }
             else if (alignment != nullptr && alignment->getInUse())
             {
                 switch (alignment->getAlignment())
@@ -342,7 +744,7 @@ namespace Logging
         }
 
         template <class... Args>
-        static void printer(const std::string &logMessage, const bool ignoreFile, const Args &...args)
+        static void printer(Record &record, const std::string &logMessage, const Args &...args)
         {
             std::vector<std::any> anyArgs = {args...};
 
@@ -352,7 +754,12 @@ namespace Logging
 
             time_t ttime = time(nullptr);
 
-            tm *local_time = localtime(&ttime);
+            record.time = ttime;
+
+            // Records are formatted on the calling thread, so the reentrant variant is needed
+            tm local_buffer;
+
+            tm *local_time = localtime_r(&ttime, &local_buffer);
 
             setTimeFormat(timeString, 1, local_time);
 
@@ -366,7 +773,7 @@ namespace Logging
 
             timeString += "] " + header + ": ";
 
-            sendOutput(timeString, ignoreFile);
+            sendOutput(record, timeString);
 
             int i = 0;
 
@@ -387,23 +794,26 @@ namespace Logging
                         if (position > argsLength)
                             LG_FATAL("\n{0} is is greater than the provided amount of arguments in:\n\t{1}", true, splitArgs[0], logMessage);
 
-                        printAtIndex(anyArgs, position, splitArgs[1], logMessage);
+                        printAtIndex(record, anyArgs, position, splitArgs[1], logMessage);
                     }
                     else
                         LG_FATAL("\n{0} is an invalid positional argument in:\n\t{1}", true, splitArgs[0], logMessage);
                 }
                 else
-                    sendOutput(logMessage[static_cast<unsigned long>(i++)], ignoreFile);
+                    sendOutput(record, logMessage[static_cast<unsigned long>(i++)]);
             }
 
-            if (logLocation == "")
+            if (record.sampleRate > 1)
+                sendOutput(record, " [sampled 1/" + std::to_string(record.sampleRate) + "]");
+
+            if (!record.toFile)
             {
-                sendOutput("\033[0m", ignoreFile);
-                sendOutput("\n", ignoreFile);
+                sendOutput(record, "\033[0m");
+                sendOutput(record, "\n");
             }
         }
 
-        static void printAtIndex(const std::vector<std::any> &args, const unsigned long index, std::string &formatting, const std::string &logMessage)
+        static void printAtIndex(Record &record, const std::vector<std::any> &args, const unsigned long index, std::string &formatting, const std::string &logMessage)
         {
             DecimalFormat decimalFormat(formatting);
 
@@ -415,61 +825,61 @@ namespace Logging
             {
                 short value = std::any_cast<short>(args[index]);
 
-                handleFormats(value, std::to_string(value), decimalFormat, alignment, truncation);
+                handleFormats(record, value, std::to_string(value), decimalFormat, alignment, truncation);
             }
             else if (args[index].type() == typeid(unsigned short))
             {
                 unsigned short value = std::any_cast<unsigned short>(args[index]);
 
-                handleFormats(value, std::to_string(static_cast<int>(value)), decimalFormat, alignment, truncation);
+                handleFormats(record, value, std::to_string(static_cast<int>(value)), decimalFormat, alignment, truncation);
             }
             else if (args[index].type() == typeid(int))
             {
                 int value = std::any_cast<int>(args[index]);
 
-                handleFormats(value, std::to_string(value), decimalFormat, alignment, truncation);
+                handleFormats(record, value, std::to_string(value), decimalFormat, alignment, truncation);
             }
             else if (args[index].type() == typeid(unsigned int))
             {
                 unsigned int value = std::any_cast<unsigned int>(args[index]);
 
-                handleFormats(value, std::to_string(value), decimalFormat, alignment, truncation);
+                handleFormats(record, value, std::to_string(value), decimalFormat, alignment, truncation);
             }
             else if (args[index].type() == typeid(long))
             {
                 long value = std::any_cast<long>(args[index]);
 
-                handleFormats(value, std::to_string(value), decimalFormat, alignment, truncation);
+                handleFormats(record, value, std::to_string(value), decimalFormat, alignment, truncation);
             }
             else if (args[index].type() == typeid(unsigned long))
             {
                 unsigned long value = std::any_cast<unsigned long>(args[index]);
 
-                handleFormats(value, std::to_string(value), decimalFormat, alignment, truncation);
+                handleFormats(record, value, std::to_string(value), decimalFormat, alignment, truncation);
             }
             else if (args[index].type() == typeid(float))
             {
                 float value = std::any_cast<float>(args[index]);
 
-                handleFormats(value, std::to_string(value), decimalFormat, alignment, truncation);
+                handleFormats(record, value, formatNumber(value, "0.6f"), decimalFormat, alignment, truncation);
             }
             else if (args[index].type() == typeid(double))
             {
                 double value = std::any_cast<double>(args[index]);
 
-                handleFormats(value, std::to_string(value), decimalFormat, alignment, truncation);
+                handleFormats(record, value, formatNumber(value, "0.6f"), decimalFormat, alignment, truncation);
             }
             else if (args[index].type() == typeid(std::string))
             {
                 std::string value = std::any_cast<std::string>(args[index]);
 
-                handleFormats(value, value, decimalFormat, alignment, truncation);
+                handleFormats(record, value, value, decimalFormat, alignment, truncation);
             }
             else if (args[index].type() == typeid(bool))
             {
                 std::string value = std::any_cast<bool>(args[index]) ? "true" : "false";
 
-                handleFormats(value, value, decimalFormat, alignment, truncation);
+                handleFormats(record, value, value, decimalFormat, alignment, truncation);
             }
             else if (std::strcmp(args[index].type().name(), "PKc") == 0)
             {
@@ -477,14 +887,14 @@ namespace Logging
 
                 std::string inString(value);
 
-                handleFormats(value, inString, decimalFormat, alignment, truncation);
+                handleFormats(record, value, inString, decimalFormat, alignment, truncation);
             }
             else
                 LG_FATAL("\nArgument {0} is not an allowed type to be printed in:\n\t{1}", index, logMessage);
         }
 
         template <typename T>
-        static void handleFormats(const T &value, const std::string &output, DecimalFormat &decimalFormat, Alignment &alignment, Truncation &truncation)
+        static void handleFormats(Record &record, const T &value, const std::string &output, DecimalFormat &decimalFormat, Alignment &alignment, Truncation &truncation)
         {
             size_t length = output.length();
 
@@ -492,13 +902,13 @@ namespace Logging
 
             truncation.setArgument(output);
 
-            handlePrintAtIndex(value, decimalFormat, alignment, truncation);
+            handlePrintAtIndex(record, value, decimalFormat, alignment, truncation);
         }
 
         template <typename T>
-        static void handlePrintAtIndex(const T &val, const DecimalFormat &decimalFormat, const Alignment &alignment, const Truncation &truncation)
+        static void handlePrintAtIndex(Record &record, const T &val, const DecimalFormat &decimalFormat, const Alignment &alignment, const Truncation &truncation)
         {
-            sendOutput(val, false, nullptr, &decimalFormat, &alignment, &truncation);
+            sendOutput(record, val, nullptr, &decimalFormat, &alignment, &truncation);
         }
 
         static void argSplitter(const std::string &argument, std::string *argArray, int &index)
@@ -0,0 +1,545 @@
+#include "logindex.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace
+{
+    const char ENTRIES_MAGIC[8] = {'L', 'G', 'I', 'D', 'X', '0', '0', '3'};
+    const char TABLES_MAGIC[8] = {'L', 'G', 'T', 'A', 'B', '0', '0', '3'};
+
+    // Entries reach the sidecar in batches of this many unless the tables are saved sooner
+    const size_t APPEND_BATCH = 256;
+
+    template <typename T>
+    void writeRaw(std::ofstream &stream, const T *values, const size_t count)
+    {
+        stream.write(reinterpret_cast<const char *>(values), static_cast<std::streamsize>(sizeof(T) * count));
+    }
+
+    template <typename T>
+    bool readRaw(std::ifstream &stream, T *values, const size_t count)
+    {
+        return static_cast<bool>(stream.read(reinterpret_cast<char *>(values), static_cast<std::streamsize>(sizeof(T) * count)));
+    }
+
+    bool appendIds(const std::filesystem::path &list, const std::vector<uint64_t> &ids)
+    {
+        std::ofstream stream(list, std::ios::out | std::ios::app | std::ios::binary);
+
+        writeRaw(stream, ids.data(), ids.size());
+
+        return static_cast<bool>(stream);
+    }
+
+    // Ids only grow, so the ones from count on are at the end of the list
+    void truncateList(const std::filesystem::path &list, const uint64_t count)
+    {
+        std::ifstream stream(list, std::ios::in | std::ios::binary);
+
+        uint64_t id;
+        uint64_t kept = 0;
+
+        while (readRaw(stream, &id, 1) && id < count)
+            kept++;
+
+        stream.close();
+
+        std::error_code error;
+
+        std::filesystem::resize_file(list, kept * sizeof(uint64_t), error);
+    }
+}
+
+Logging::LogIndex::LogIndex(const std::filesystem::path &log, const int64_t seconds, const uint64_t logBytes) : indexedLog(log), sidecar(sidecarPath(log)), tables(tablesPath(log)), bucketSeconds(seconds < 1 ? 1 : seconds), entryCount(0)
+{
+    if (logBytes > 0)
+        resume(logBytes);
+
+    if (entryCount > 0)
+    {
+        entries.open(sidecar, std::ios::out | std::ios::app | std::ios::binary);
+
+        return;
+    }
+
+    // Nothing of an older index next to the same log may leak into the new one
+    sections.clear();
+    sectionIds.clear();
+
+    removeFiles(log);
+
+    entries.open(sidecar, std::ios::out | std::ios::trunc | std::ios::binary);
+
+    Header header;
+
+    std::memcpy(header.magic, ENTRIES_MAGIC, sizeof(ENTRIES_MAGIC));
+
+    header.bucketSeconds = static_cast<uint64_t>(bucketSeconds);
+
+    writeRaw(entries, &header, 1);
+
+    entries.flush();
+}
+
+Logging::LogIndex::~LogIndex()
+{
+    save();
+}
+
+void Logging::LogIndex::add(const uint64_t offset, const uint64_t length, const RecordMeta &meta)
+{
+    std::unordered_map<std::string, uint32_t>::const_iterator found = sectionIds.find(meta.section);
+
+    const bool newSection = found == sectionIds.end();
+
+    uint32_t section;
+
+    if (newSection)
+    {
+        section = static_cast<uint32_t>(sections.size());
+
+        sectionIds.emplace(meta.section, section);
+        sections.push_back(meta.section);
+
+        // Created up front so the section lists on disk always run from 0 without gaps
+        std::ofstream(sectionPath(indexedLog, section), std::ios::out | std::ios::app | std::ios::binary);
+    }
+    else
+        section = found->second;
+
+    const Entry entry = {offset, length, meta.time, std::min(meta.level, LEVEL_COUNT - 1), section};
+
+    summarise(entry, entryCount);
+
+    pending.push_back(entry);
+    entryCount++;
+
+    // A new section or a full interval updates the tables, other entries are only appended
+    if (newSection || entryCount % TABLES_INTERVAL == 0)
+        save();
+    else if (pending.size() >= APPEND_BATCH)
+        appendPending();
+}
+
+bool Logging::LogIndex::save()
+{
+    const bool appended = appendPending();
+
+    return saveTables() && appended;
+}
+
+std::filesystem::path Logging::LogIndex::sidecarPath(const std::filesystem::path &log)
+{
+    std::filesystem::path sidecar = log;
+
+    sidecar += ".idx";
+
+    return sidecar;
+}
+
+std::filesystem::path Logging::LogIndex::tablesPath(const std::filesystem::path &log)
+{
+    std::filesystem::path summary = log;
+
+    summary += ".idx.tables";
+
+    return summary;
+}
+
+std::filesystem::path Logging::LogIndex::levelPath(const std::filesystem::path &log, const uint32_t level)
+{
+    std::filesystem::path list = log;
+
+    list += ".idx.level" + std::to_string(level);
+
+    return list;
+}
+
+std::filesystem::path Logging::LogIndex::sectionPath(const std::filesystem::path &log, const uint64_t section)
+{
+    std::filesystem::path list = log;
+
+    list += ".idx.section" + std::to_string(section);
+
+    return list;
+}
+
+void Logging::LogIndex::removeFiles(const std::filesystem::path &log)
+{
+    std::error_code error;
+
+    std::filesystem::remove(sidecarPath(log), error);
+    std::filesystem::remove(tablesPath(log), error);
+
+    for (uint32_t level = 0; level < LEVEL_COUNT; level++)
+        std::filesystem::remove(levelPath(log, level), error);
+
+    for (uint64_t section = 0; std::filesystem::remove(sectionPath(log, section), error); section++)
+        ;
+}
+
+void Logging::LogIndex::resume(const uint64_t logBytes)
+{
+    std::ifstream existing(sidecar, std::ios::in | std::ios::binary);
+
+    Header header;
+
+    if (!readRaw(existing, &header, 1) || std::memcmp(header.magic, ENTRIES_MAGIC, sizeof(ENTRIES_MAGIC)) != 0 || header.bucketSeconds != static_cast<uint64_t>(bucketSeconds))
+        return;
+
+    // Section names only live in the tables, a section saved after them is left unnamed
+    std::ifstream summary(tables, std::ios::in | std::ios::binary);
+
+    Tables counts;
+
+    uint64_t listed = 0;
+
+    if (readRaw(summary, &counts, 1) && std::memcmp(counts.magic, TABLES_MAGIC, sizeof(TABLES_MAGIC)) == 0)
+    {
+        listed = counts.entryCount;
+
+        std::vector<Section> table(counts.sectionCount);
+
+        summary.seekg(static_cast<std::streamoff>(sizeof(Tables) + counts.sectionCount * sizeof(Section) + counts.bucketCount * sizeof(Bucket)));
+
+        std::string names(counts.stringBytes, '\0');
+
+        summary.read(names.data(), static_cast<std::streamsize>(names.length()));
+
+        summary.seekg(static_cast<std::streamoff>(sizeof(Tables)));
+
+        if (readRaw(summary, table.data(), table.size()))
+        {
+            for (const Section &section : table)
+            {
+                if (section.nameOffset + section.nameLength > names.length())
+                    break;
+
+                sectionIds.emplace(names.substr(section.nameOffset, section.nameLength), static_cast<uint32_t>(sections.size()));
+                sections.push_back(names.substr(section.nameOffset, section.nameLength));
+            }
+        }
+    }
+
+    // Only entries for records still in the log are kept, in case it was cut short
+    std::vector<Entry> unlisted;
+
+    Entry entry;
+
+    while (readRaw(existing, &entry, 1) && entry.offset + entry.length <= logBytes && entry.level < LEVEL_COUNT)
+    {
+        while (entry.section >= sections.size())
+            sections.push_back("");
+
+        summarise(entry, entryCount);
+
+        if (entryCount >= listed)
+            unlisted.push_back(entry);
+
+        entryCount++;
+    }
+
+    existing.close();
+
+    std::error_code error;
+
+    std::filesystem::resize_file(sidecar, sizeof(Header) + entryCount * sizeof(Entry), error);
+
+    // The lists may have been cut anywhere after the tables were saved, so they go back to what the tables covered
+    // and the entries written since are listed again
+    listed = std::min(listed, entryCount);
+
+    for (uint32_t level = 0; level < LEVEL_COUNT; level++)
+        truncateList(levelPath(indexedLog, level), listed);
+
+    for (uint64_t section = 0; section < sections.size(); section++)
+    {
+        truncateList(sectionPath(indexedLog, section), listed);
+
+        std::ofstream(sectionPath(indexedLog, section), std::ios::out | std::ios::app | std::ios::binary);
+    }
+
+    for (uint64_t section = sections.size(); std::filesystem::remove(sectionPath(indexedLog, section), error); section++)
+        ;
+
+    appendLists(unlisted, listed);
+}
+
+void Logging::LogIndex::summarise(const Entry &entry, const uint64_t id)
+{
+    const int64_t start = entry.time - ((entry.time % bucketSeconds) + bucketSeconds) % bucketSeconds;
+
+    // Ids only grow, so the first one seen in a bucket is its lowest and the latest its highest
+    buckets.try_emplace(start, Bucket{start, id, id}).first->second.lastEntry = id;
+}
+
+bool Logging::LogIndex::appendPending()
+{
+    if (pending.empty())
+        return static_cast<bool>(entries);
+
+    writeRaw(entries, pending.data(), pending.size());
+
+    entries.flush();
+
+    const bool listed = appendLists(pending, entryCount - pending.size());
+
+    pending.clear();
+
+    return static_cast<bool>(entries) && listed;
+}
+
+bool Logging::LogIndex::appendLists(const std::vector<Entry> &batch, const uint64_t firstId) const
+{
+    std::vector<std::vector<uint64_t>> levels(LEVEL_COUNT);
+    std::map<uint32_t, std::vector<uint64_t>> sectionLists;
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        levels[batch[i].level].push_back(firstId + i);
+        sectionLists[batch[i].section].push_back(firstId + i);
+    }
+
+    bool appended = true;
+
+    for (uint32_t level = 0; level < LEVEL_COUNT; level++)
+        if (!levels[level].empty())
+            appended = appendIds(levelPath(indexedLog, level), levels[level]) && appended;
+
+    for (const std::pair<const uint32_t, std::vector<uint64_t>> &list : sectionLists)
+        appended = appendIds(sectionPath(indexedLog, list.first), list.second) && appended;
+
+    return appended;
+}
+
+bool Logging::LogIndex::saveTables() const
+{
+    std::vector<Section> sectionTable;
+    std::string strings;
+
+    for (const std::string &section : sections)
+    {
+        sectionTable.push_back({strings.length(), section.length()});
+
+        strings += section;
+    }
+
+    std::vector<Bucket> bucketTable;
+
+    for (const std::pair<const int64_t, Bucket> &bucket : buckets)
+        bucketTable.push_back(bucket.second);
+
+    // Records may reach the file slightly out of time order, so a bucket starts at the first entry that is not older
+    // and ends at the last one that is not newer
+    for (size_t bucket = bucketTable.size(); bucket-- > 1;)
+        bucketTable[bucket - 1].firstEntry = std::min(bucketTable[bucket - 1].firstEntry, bucketTable[bucket].firstEntry);
+
+    for (size_t bucket = 1; bucket < bucketTable.size(); bucket++)
+        bucketTable[bucket].lastEntry = std::max(bucketTable[bucket].lastEntry, bucketTable[bucket - 1].lastEntry);
+
+    Tables counts;
+
+    std::memcpy(counts.magic, TABLES_MAGIC, sizeof(TABLES_MAGIC));
+
+    counts.entryCount = entryCount;
+    counts.sectionCount = sectionTable.size();
+    counts.bucketCount = bucketTable.size();
+    counts.stringBytes = strings.length();
+
+    // Written to the side and renamed so a reader never maps half written tables
+    std::filesystem::path temporary = tables;
+
+    temporary += ".tmp";
+
+    std::ofstream stream(temporary, std::ios::out | std::ios::trunc | std::ios::binary);
+
+    writeRaw(stream, &counts, 1);
+    writeRaw(stream, sectionTable.data(), sectionTable.size());
+    writeRaw(stream, bucketTable.data(), bucketTable.size());
+    writeRaw(stream, strings.data(), strings.length());
+
+    stream.close();
+
+    if (!stream)
+        return false;
+
+    std::error_code error;
+
+    std::filesystem::rename(temporary, tables, error);
+
+    return !error;
+}
+
+Logging::MappedFile::MappedFile(const std::filesystem::path &path) : data(nullptr), length(0)
+{
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return;
+
+    struct stat info;
+
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        void *mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (mapped != MAP_FAILED)
+        {
+            data = static_cast<const char *>(mapped);
+            length = static_cast<size_t>(info.st_size);
+        }
+    }
+
+    close(fd);
+}
+
+Logging::MappedFile::~MappedFile()
+{
+    if (data)
+        munmap(const_cast<char *>(data), length);
+}
+
+const char *Logging::MappedFile::getData() const
+{
+    return data;
+}
+
+size_t Logging::MappedFile::getLength() const
+{
+    return length;
+}
+
+Logging::LogIndexView::LogIndexView(const std::filesystem::path &log) : indexedLog(log), entryFile(LogIndex::sidecarPath(log)), tableFile(LogIndex::tablesPath(log)), header(nullptr), entries(nullptr), entryCount(0), summary(nullptr), sections(nullptr), buckets(nullptr), strings(nullptr)
+{
+    if (entryFile.getLength() < sizeof(LogIndex::Header))
+        return;
+
+    const LogIndex::Header *candidate = reinterpret_cast<const LogIndex::Header *>(entryFile.getData());
+
+    if (std::memcmp(candidate->magic, ENTRIES_MAGIC, sizeof(ENTRIES_MAGIC)) != 0 || candidate->bucketSeconds == 0)
+        return;
+
+    header = candidate;
+    entries = reinterpret_cast<const LogIndex::Entry *>(entryFile.getData() + sizeof(LogIndex::Header));
+    entryCount = (entryFile.getLength() - sizeof(LogIndex::Header)) / sizeof(LogIndex::Entry);
+
+    // Without usable tables every entry is scanned and sections have no names
+    if (tableFile.getLength() < sizeof(LogIndex::Tables))
+        return;
+
+    const LogIndex::Tables *counts = reinterpret_cast<const LogIndex::Tables *>(tableFile.getData());
+
+    const size_t expected = sizeof(LogIndex::Tables) + counts->sectionCount * sizeof(LogIndex::Section) + counts->bucketCount * sizeof(LogIndex::Bucket) + counts->stringBytes;
+
+    if (std::memcmp(counts->magic, TABLES_MAGIC, sizeof(TABLES_MAGIC)) != 0 || expected != tableFile.getLength())
+        return;
+
+    summary = counts;
+
+    const char *cursor = tableFile.getData() + sizeof(LogIndex::Tables);
+
+    sections = reinterpret_cast<const LogIndex::Section *>(cursor);
+    cursor += summary->sectionCount * sizeof(LogIndex::Section);
+
+    buckets = reinterpret_cast<const LogIndex::Bucket *>(cursor);
+    cursor += summary->bucketCount * sizeof(LogIndex::Bucket);
+
+    strings = cursor;
+}
+
+Logging::LogIndexView::~LogIndexView() = default;
+
+bool Logging::LogIndexView::isValid() const
+{
+    return header != nullptr;
+}
+
+uint64_t Logging::LogIndexView::getEntryCount() const
+{
+    return entryCount;
+}
+
+const Logging::LogIndex::Entry &Logging::LogIndexView::getEntry(const uint64_t id) const
+{
+    return entries[id];
+}
+
+const Logging::LogIndex::Entry *Logging::LogIndexView::findEntryAt(const uint64_t offset) const
+{
+    const LogIndex::Entry *end = entries + entryCount;
+
+    const LogIndex::Entry *found = std::lower_bound(entries, end, offset, [](const LogIndex::Entry &entry, const uint64_t value)
+                                                    { return entry.offset < value; });
+
+    return found != end && found->offset == offset ? found : nullptr;
+}
+
+int64_t Logging::LogIndexView::getBucketSeconds() const
+{
+    return static_cast<int64_t>(header->bucketSeconds);
+}
+
+uint64_t Logging::LogIndexView::getSectionCount() const
+{
+    return summary ? summary->sectionCount : 0;
+}
+
+std::string Logging::LogIndexView::getSectionName(const uint64_t section) const
+{
+    if (section >= getSectionCount())
+        return "";
+
+    return std::string(strings + sections[section].nameOffset, sections[section].nameLength);
+}
+
+uint64_t Logging::LogIndexView::getSummarisedCount() const
+{
+    return summary ? std::min(summary->entryCount, entryCount) : 0;
+}
+
+std::vector<uint64_t> Logging::LogIndexView::getSectionEntries(const uint64_t section) const
+{
+    return collect(LogIndex::sectionPath(indexedLog, section), [section](const LogIndex::Entry &entry)
+                   { return entry.section == section; });
+}
+
+std::vector<uint64_t> Logging::LogIndexView::getLevelEntries(const uint32_t level) const
+{
+    return collect(LogIndex::levelPath(indexedLog, level), [level](const LogIndex::Entry &entry)
+                   { return entry.level == level; });
+}
+
+uint64_t Logging::LogIndexView::getFirstEntryAt(const int64_t time) const
+{
+    if (summary == nullptr)
+        return 0;
+
+    const LogIndex::Bucket *end = buckets + summary->bucketCount;
+
+    const int64_t seconds = getBucketSeconds();
+
+    // First bucket that still covers the given time
+    const LogIndex::Bucket *bucket = std::partition_point(buckets, end, [time, seconds](const LogIndex::Bucket &candidate)
+                                                          { return candidate.start + seconds <= time; });
+
+    // Past the saved buckets only the entries after the tables can match
+    return bucket != end ? bucket->firstEntry : getSummarisedCount();
+}
+
+uint64_t Logging::LogIndexView::getLastEntryAt(const int64_t time) const
+{
+    if (summary == nullptr)
+        return 0;
+
+    const LogIndex::Bucket *end = buckets + summary->bucketCount;
+
+    // First bucket that starts after the given time, everything it and later buckets hold alone is too new
+    const LogIndex::Bucket *bucket = std::partition_point(buckets, end, [time](const LogIndex::Bucket &candidate)
+                                                          { return candidate.start <= time; });
+
+    return bucket == buckets ? 0 : std::min((bucket - 1)->lastEntry + 1, getSummarisedCount());
+}
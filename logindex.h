@@ -0,0 +1,218 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <fstream>
+#include <filesystem>
+#include <cstdint>
+#include <ctime>
+
+namespace Logging
+{
+
+    // What the index needs to know about a record besides where it landed in the file
+    struct RecordMeta
+    {
+        bool indexed = false;
+        int64_t time = 0;
+        uint32_t level = 0;
+        std::string section;
+
+        // Steady clock nanoseconds taken when the record was formatted, 0 when the sink should take its own
+        uint64_t timestamp = 0;
+    };
+
+    // Sidecar index written next to a log, so logq can answer queries without reading the whole log. Every file but
+    // the tables is only ever appended to, all integers native endian:
+    //
+    //     <log>.idx             Header, Entry[] in the order the records were written
+    //     <log>.idx.level<N>    uint64_t ids of the entries at level N
+    //     <log>.idx.section<N>  uint64_t ids of the entries under section N
+    //     <log>.idx.tables      Tables, Section[sectionCount], Bucket[bucketCount], section names
+    //
+    // The tables name the sections and give per time bucket the first and last entry that can fall in it. They are
+    // rewritten on a new section and every TABLES_INTERVAL entries and cover the entries written up to then, readers
+    // scan the entries past them in full.
+    class LogIndex
+    {
+    public:
+        static const uint32_t LEVEL_COUNT = 5;
+        static const uint64_t TABLES_INTERVAL = 4096;
+
+        struct Header
+        {
+            char magic[8];
+            uint64_t bucketSeconds;
+        };
+
+        struct Entry
+        {
+            uint64_t offset;
+            uint64_t length;
+            int64_t time;
+            uint32_t level;
+            uint32_t section;
+        };
+
+        struct Tables
+        {
+            char magic[8];
+            uint64_t entryCount;
+            uint64_t sectionCount;
+            uint64_t bucketCount;
+            uint64_t stringBytes;
+        };
+
+        struct Section
+        {
+            uint64_t nameOffset;
+            uint64_t nameLength;
+        };
+
+        struct Bucket
+        {
+            int64_t start;
+            uint64_t firstEntry;
+            uint64_t lastEntry;
+        };
+
+        // Picks up an existing sidecar for the first logBytes of the log, a log of 0 bytes starts a new one
+        LogIndex(const std::filesystem::path &log, const int64_t seconds, const uint64_t logBytes);
+        ~LogIndex();
+
+        LogIndex(const LogIndex &) = delete;
+        LogIndex &operator=(const LogIndex &) = delete;
+
+        void add(const uint64_t offset, const uint64_t length, const RecordMeta &meta);
+
+        // Appends the entries not on disk yet and rewrites the tables
+        bool save();
+
+        static std::filesystem::path sidecarPath(const std::filesystem::path &log);
+
+        static std::filesystem::path tablesPath(const std::filesystem::path &log);
+
+        static std::filesystem::path levelPath(const std::filesystem::path &log, const uint32_t level);
+
+        static std::filesystem::path sectionPath(const std::filesystem::path &log, const uint64_t section);
+
+        // Removes every file of the index kept next to the log
+        static void removeFiles(const std::filesystem::path &log);
+
+    private:
+        std::filesystem::path indexedLog;
+        std::filesystem::path sidecar;
+        std::filesystem::path tables;
+        int64_t bucketSeconds;
+        uint64_t entryCount;
+        std::ofstream entries;
+        std::vector<Entry> pending;
+        std::vector<std::string> sections;
+        std::unordered_map<std::string, uint32_t> sectionIds;
+        std::map<int64_t, Bucket> buckets;
+
+        void resume(const uint64_t logBytes);
+
+        void summarise(const Entry &entry, const uint64_t id);
+
+        bool appendPending();
+
+        // Adds the ids of a batch of entries, the first of them with the given id, to their level and section lists
+        bool appendLists(const std::vector<Entry> &batch, const uint64_t firstId) const;
+
+        bool saveTables() const;
+    };
+
+    // Read-only mapping of a whole file, empty when it cannot be opened or has no bytes
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::filesystem::path &path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const char *getData() const;
+
+        size_t getLength() const;
+
+    private:
+        const char *data;
+        size_t length;
+    };
+
+    // Read-only view of a sidecar index mapped into memory
+    class LogIndexView
+    {
+    public:
+        explicit LogIndexView(const std::filesystem::path &log);
+        ~LogIndexView();
+
+        LogIndexView(const LogIndexView &) = delete;
+        LogIndexView &operator=(const LogIndexView &) = delete;
+
+        bool isValid() const;
+
+        uint64_t getEntryCount() const;
+        const LogIndex::Entry &getEntry(const uint64_t id) const;
+
+        // Entry written at the given offset of the log, entries are stored in the order they were written
+        const LogIndex::Entry *findEntryAt(const uint64_t offset) const;
+
+        int64_t getBucketSeconds() const;
+
+        // Entries the tables cover, any after them have no time bounds
+        uint64_t getSummarisedCount() const;
+
+        uint64_t getSectionCount() const;
+        std::string getSectionName(const uint64_t section) const;
+        std::vector<uint64_t> getSectionEntries(const uint64_t section) const;
+
+        std::vector<uint64_t> getLevelEntries(const uint32_t level) const;
+
+        // First entry that can have a time of at least the given one
+        uint64_t getFirstEntryAt(const int64_t time) const;
+
+        // One past the last summarised entry that can have a time of at most the given one
+        uint64_t getLastEntryAt(const int64_t time) const;
+
+    private:
+        std::filesystem::path indexedLog;
+        MappedFile entryFile;
+        MappedFile tableFile;
+        const LogIndex::Header *header;
+        const LogIndex::Entry *entries;
+        uint64_t entryCount;
+        const LogIndex::Tables *summary;
+        const LogIndex::Section *sections;
+        const LogIndex::Bucket *buckets;
+        const char *strings;
+
+        // Ids from the list that the tables cover, then every later entry that matches, in id order
+        template <typename Match>
+        std::vector<uint64_t> collect(const std::filesystem::path &list, Match match) const
+        {
+            std::vector<uint64_t> found;
+
+            const uint64_t summarised = getSummarisedCount();
+
+            const MappedFile listed(list);
+
+            const uint64_t *first = reinterpret_cast<const uint64_t *>(listed.getData());
+            const uint64_t *last = first + listed.getLength() / sizeof(uint64_t);
+
+            for (const uint64_t *id = first; id != last && *id < summarised; id++)
+                found.push_back(*id);
+
+            for (uint64_t id = summarised; id < entryCount; id++)
+                if (match(entries[id]))
+                    found.push_back(id);
+
+            return found;
+        }
+    };
+}
@@ -0,0 +1,481 @@
+#include "shardsink.h"
+
+#include <sstream>
+#include <algorithm>
+#include <tuple>
+#include <sched.h>
+#include <pthread.h>
+
+namespace
+{
+    struct Frame
+    {
+        uint64_t timestamp;
+        uint64_t shard;
+        uint64_t sequence;
+        size_t segment;
+        const char *body;
+        size_t length;
+    };
+
+    uint64_t readNumber(const char *&cursor, const char *end)
+    {
+        uint64_t value = 0;
+
+        while (cursor < end && *cursor >= '0' && *cursor <= '9')
+            value = value * 10 + static_cast<uint64_t>(*cursor++ - '0');
+
+        if (cursor < end && (*cursor == ' ' || *cursor == '\n'))
+            cursor++;
+
+        return value;
+    }
+
+    bool parseFrames(const Logging::MappedFile &segment, const size_t index, std::vector<Frame> &frames)
+    {
+        const char *cursor = segment.getData();
+        const char *end = segment.getData() + segment.getLength();
+
+        while (cursor < end)
+        {
+            if (end - cursor < 2 || cursor[0] != '%' || cursor[1] != '@')
+                return false;
+
+            cursor += 2;
+
+            Frame frame;
+
+            frame.timestamp = readNumber(cursor, end);
+            frame.shard = readNumber(cursor, end);
+            frame.sequence = readNumber(cursor, end);
+            frame.segment = index;
+            frame.length = readNumber(cursor, end);
+            frame.body = cursor;
+
+            if (frame.length > static_cast<size_t>(end - cursor))
+                return false;
+
+            cursor += frame.length;
+
+            frames.push_back(frame);
+        }
+
+        return true;
+    }
+}
+
+Logging::ShardedFileSink::ShardedFileSink(const std::filesystem::path &path, const Granularity granularity, const size_t capacity, const bool useUring, const int indexBucketSeconds) : shardCapacity(capacity < 1 ? 1 : capacity), writeLatencyTotal(0), writeLatencyCount(0)
+{
+    const std::vector<std::vector<int>> topology = discoverTopology(granularity);
+
+    // Segments left by a run with more shards would otherwise be merged into this one
+    removeSegments(path, topology.size());
+
+    for (size_t i = 0; i < topology.size(); i++)
+    {
+        std::unique_ptr<Shard> shard = std::make_unique<Shard>();
+
+        shard->cpus = topology[i];
+
+        shard->segment = segmentPath(path, i);
+
+        if (useUring)
+        {
+            std::filesystem::remove(shard->segment);
+
+            shard->uringSink = std::make_unique<UringFileSink>(shard->segment);
+
+            if (!shard->uringSink->isOpen())
+                shard->uringSink.reset();
+        }
+
+        if (!shard->uringSink)
+            shard->stream.open(shard->segment, std::ios::out | std::ios::trunc | std::ios::binary);
+
+        // Each segment gets its own index, logmerge combines them along with the records
+        if (indexBucketSeconds > 0)
+            shard->index = std::make_unique<LogIndex>(shard->segment, indexBucketSeconds, 0);
+        else
+            LogIndex::removeFiles(shard->segment);
+
+        for (const int cpu : shard->cpus)
+        {
+            if (cpuToShard.size() <= static_cast<size_t>(cpu))
+                cpuToShard.resize(static_cast<size_t>(cpu) + 1, i);
+
+            cpuToShard[static_cast<size_t>(cpu)] = i;
+        }
+
+        shards.push_back(std::move(shard));
+    }
+
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        Shard &shard = *shards[i];
+
+        shard.worker = std::thread(&ShardedFileSink::drainShard, this, i);
+
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+
+        for (const int cpu : shard.cpus)
+            CPU_SET(static_cast<size_t>(cpu), &set);
+
+        // Pinning is best effort, an unpinned worker still keeps its shard's segment ordered
+        pthread_setaffinity_np(shard.worker.native_handle(), sizeof(cpu_set_t), &set);
+    }
+}
+
+Logging::ShardedFileSink::~ShardedFileSink()
+{
+    for (std::unique_ptr<Shard> &shard : shards)
+    {
+        {
+            std::lock_guard<std::mutex> lock(shard->queueMutex);
+
+            shard->stop = true;
+        }
+
+        shard->ready.notify_one();
+    }
+
+    for (std::unique_ptr<Shard> &shard : shards)
+        shard->worker.join();
+
+    flush();
+}
+
+bool Logging::ShardedFileSink::write(const std::string &text, const RecordMeta &meta, const bool block)
+{
+    const uint64_t timestamp = meta.timestamp != 0 ? meta.timestamp : static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+
+    Shard &shard = *shards[currentShard()];
+
+    std::unique_lock<std::mutex> lock(shard.queueMutex);
+
+    if (shard.records.size() >= shardCapacity)
+    {
+        if (!block)
+            return false;
+
+        shard.drained.wait(lock, [this, &shard]()
+                           { return shard.records.size() < shardCapacity; });
+    }
+
+    shard.records.push_back({timestamp, text, meta});
+    shard.enqueued++;
+
+    lock.unlock();
+    shard.ready.notify_one();
+
+    return true;
+}
+
+void Logging::ShardedFileSink::flush()
+{
+    for (std::unique_ptr<Shard> &shard : shards)
+    {
+        {
+            std::unique_lock<std::mutex> lock(shard->queueMutex);
+
+            const uint64_t target = shard->enqueued;
+
+            shard->drained.wait(lock, [&shard, target]()
+                                { return shard->written >= target || shard->stop; });
+        }
+
+        std::lock_guard<std::mutex> writer(shard->writerMutex);
+
+        if (shard->uringSink)
+            shard->uringSink->flush();
+        else
+            shard->stream.flush();
+
+        if (shard->index)
+            shard->index->save();
+    }
+}
+
+bool Logging::ShardedFileSink::waitUntilDrained(const std::chrono::steady_clock::time_point deadline)
+{
+    for (std::unique_ptr<Shard> &shard : shards)
+    {
+        std::unique_lock<std::mutex> lock(shard->queueMutex);
+
+        if (!shard->drained.wait_until(lock, deadline, [&shard]()
+                                       { return shard->written == shard->enqueued; }))
+            return false;
+    }
+
+    return true;
+}
+
+double Logging::ShardedFileSink::getQueueFill() const
+{
+    size_t fullest = 0;
+
+    for (const std::unique_ptr<Shard> &shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard->queueMutex);
+
+        fullest = std::max(fullest, shard->records.size());
+    }
+
+    return static_cast<double>(fullest) / static_cast<double>(shardCapacity);
+}
+
+void Logging::ShardedFileSink::takeWriteLatency(int64_t &total, int64_t &count)
+{
+    total = writeLatencyTotal.exchange(0);
+    count = writeLatencyCount.exchange(0);
+}
+
+bool Logging::ShardedFileSink::usingUringSinks() const
+{
+    for (const std::unique_ptr<Shard> &shard : shards)
+        if (!shard->uringSink)
+            return false;
+
+    return true;
+}
+
+std::filesystem::path Logging::ShardedFileSink::segmentPath(const std::filesystem::path &path, const size_t shard)
+{
+    std::filesystem::path segment = path;
+
+    segment.replace_filename(path.stem().string() + ".shard" + std::to_string(shard) + path.extension().string());
+
+    return segment;
+}
+
+int64_t Logging::ShardedFileSink::segmentIndexSeconds(const std::filesystem::path &path)
+{
+    int64_t seconds = 0;
+
+    for (size_t shard = 0; std::filesystem::exists(segmentPath(path, shard)); shard++)
+    {
+        const LogIndexView index(segmentPath(path, shard));
+
+        if (!index.isValid() || (seconds != 0 && index.getBucketSeconds() != seconds))
+            return 0;
+
+        seconds = index.getBucketSeconds();
+    }
+
+    return seconds;
+}
+
+bool Logging::ShardedFileSink::mergeSegments(const std::filesystem::path &path, std::ostream &out, const uint64_t offset, LogIndex *index, size_t &segments, size_t &records)
+{
+    std::vector<std::unique_ptr<MappedFile>> mapped;
+    std::vector<Frame> frames;
+
+    for (segments = 0; std::filesystem::exists(segmentPath(path, segments)); segments++)
+    {
+        mapped.push_back(std::make_unique<MappedFile>(segmentPath(path, segments)));
+
+        if (!parseFrames(*mapped.back(), segments, frames))
+            return false;
+    }
+
+    std::sort(frames.begin(), frames.end(), [](const Frame &left, const Frame &right)
+              { return std::tie(left.timestamp, left.shard, left.sequence) < std::tie(right.timestamp, right.shard, right.sequence); });
+
+    std::vector<std::unique_ptr<LogIndexView>> views;
+
+    for (size_t shard = 0; index && shard < segments; shard++)
+        views.push_back(std::make_unique<LogIndexView>(segmentPath(path, shard)));
+
+    uint64_t position = offset;
+
+    for (const Frame &frame : frames)
+    {
+        out.write(frame.body, static_cast<std::streamsize>(frame.length));
+
+        const LogIndex::Entry *entry = views.empty() || !views[frame.segment]->isValid() ? nullptr : views[frame.segment]->findEntryAt(static_cast<uint64_t>(frame.body - mapped[frame.segment]->getData()));
+
+        if (entry)
+        {
+            RecordMeta meta;
+
+            meta.indexed = true;
+            meta.time = entry->time;
+            meta.level = entry->level;
+            meta.section = views[frame.segment]->getSectionName(entry->section);
+
+            index->add(position, frame.length, meta);
+        }
+
+        position += frame.length;
+    }
+
+    records = frames.size();
+
+    return true;
+}
+
+void Logging::ShardedFileSink::removeSegments(const std::filesystem::path &path, const size_t first)
+{
+    std::error_code error;
+
+    for (size_t shard = first; std::filesystem::exists(segmentPath(path, shard)); shard++)
+    {
+        LogIndex::removeFiles(segmentPath(path, shard));
+        std::filesystem::remove(segmentPath(path, shard), error);
+    }
+}
+
+void Logging::ShardedFileSink::drainShard(const size_t index)
+{
+    Shard &shard = *shards[index];
+
+    std::unique_lock<std::mutex> lock(shard.queueMutex);
+
+    while (true)
+    {
+        shard.ready.wait(lock, [&shard]()
+                         { return !shard.records.empty() || shard.stop; });
+
+        if (shard.records.empty() && shard.stop)
+            break;
+
+        std::deque<FramedRecord> batch;
+
+        batch.swap(shard.records);
+
+        lock.unlock();
+        shard.drained.notify_all();
+
+        writeFramed(index, batch);
+
+        lock.lock();
+
+        shard.written += batch.size();
+
+        shard.drained.notify_all();
+    }
+}
+
+void Logging::ShardedFileSink::writeFramed(const size_t index, const std::deque<FramedRecord> &batch)
+{
+    Shard &shard = *shards[index];
+
+    std::string framed;
+
+    std::lock_guard<std::mutex> writer(shard.writerMutex);
+
+    for (const FramedRecord &record : batch)
+    {
+        framed += "%@" + std::to_string(record.timestamp) + " " + std::to_string(index) + " " + std::to_string(shard.sequence++) + " " + std::to_string(record.text.length()) + "\n";
+
+        if (shard.index && record.meta.indexed)
+            shard.index->add(shard.bytes + framed.length(), record.text.length(), record.meta);
+
+        framed += record.text;
+    }
+
+    shard.bytes += framed.length();
+
+    // Timed per batch and spread over its records, so it stays comparable to the per record unsharded writes
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (shard.uringSink)
+        shard.uringSink->write(framed);
+    else
+        shard.stream << framed;
+
+    writeLatencyTotal += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    writeLatencyCount += static_cast<int64_t>(batch.size());
+}
+
+size_t Logging::ShardedFileSink::currentShard() const
+{
+    const int cpu = sched_getcpu();
+
+    if (cpu >= 0 && static_cast<size_t>(cpu) < cpuToShard.size())
+        return cpuToShard[static_cast<size_t>(cpu)];
+
+    return cpu < 0 ? 0 : static_cast<size_t>(cpu) % shards.size();
+}
+
+std::vector<std::vector<int>> Logging::ShardedFileSink::discoverTopology(const Granularity granularity)
+{
+    cpu_set_t allowed;
+
+    CPU_ZERO(&allowed);
+
+    sched_getaffinity(0, sizeof(cpu_set_t), &allowed);
+
+    std::vector<int> usable;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(static_cast<size_t>(cpu), &allowed))
+            usable.push_back(cpu);
+
+    if (usable.empty())
+        usable.push_back(0);
+
+    std::vector<std::vector<int>> topology;
+
+    if (granularity == Granularity::CORE)
+    {
+        for (const int cpu : usable)
+            topology.push_back({cpu});
+
+        return topology;
+    }
+
+    const std::filesystem::path nodes = "/sys/devices/system/node";
+
+    std::error_code error;
+
+    for (size_t node = 0; std::filesystem::exists(nodes / ("node" + std::to_string(node)), error); node++)
+    {
+        std::ifstream cpulist(nodes / ("node" + std::to_string(node)) / "cpulist");
+
+        std::string list;
+
+        std::getline(cpulist, list);
+
+        std::vector<int> cpus;
+
+        for (const int cpu : parseCpuList(list))
+            if (std::find(usable.begin(), usable.end(), cpu) != usable.end())
+                cpus.push_back(cpu);
+
+        if (!cpus.empty())
+            topology.push_back(cpus);
+    }
+
+    // Without NUMA information the whole machine is one node
+    if (topology.empty())
+        topology.push_back(usable);
+
+    return topology;
+}
+
+std::vector<int> Logging::ShardedFileSink::parseCpuList(const std::string &list)
+{
+    std::vector<int> cpus;
+
+    std::stringstream ss(list);
+
+    std::string range;
+
+    while (std::getline(ss, range, ','))
+    {
+        if (range.empty())
+            continue;
+
+        const size_t dash = range.find('-');
+
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+
+        for (int cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+    }
+
+    return cpus;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <cstdint>
+
+#include "uringsink.h"
+#include "logindex.h"
+
+namespace Logging
+{
+
+    // Splits file output into one queue, worker and segment file per core or per NUMA node. Every record is framed
+    // in its segment as "%@<timestamp> <shard> <sequence> <length>" followed by the record itself, so mergeSegments can
+    // rebuild the single ordered document. The frame line is a LaTeX comment, which keeps each segment readable.
+    class ShardedFileSink
+    {
+    public:
+        enum Granularity
+        {
+            CORE,
+            NUMA_NODE
+        };
+
+        ShardedFileSink(const std::filesystem::path &path, const Granularity granularity, const size_t capacity, const bool useUring, const int indexBucketSeconds = 0);
+        ~ShardedFileSink();
+
+        ShardedFileSink(const ShardedFileSink &) = delete;
+        ShardedFileSink &operator=(const ShardedFileSink &) = delete;
+
+        // Queues the record on the calling core's shard, returning false instead of waiting when block is unset
+        bool write(const std::string &text, const RecordMeta &meta, const bool block = true);
+
+        void flush();
+
+        bool waitUntilDrained(const std::chrono::steady_clock::time_point deadline);
+
+        // How full the fullest shard queue is, from 0 to 1
+        double getQueueFill() const;
+
+        // Nanoseconds spent writing records to the segments and how many were written since the last call
+        void takeWriteLatency(int64_t &total, int64_t &count);
+
+        // False when any segment had to fall back to a stream because its io_uring sink could not open it
+        bool usingUringSinks() const;
+
+        static std::filesystem::path segmentPath(const std::filesystem::path &path, const size_t shard);
+
+        // Bucket seconds shared by the indexes of every segment next to path, 0 unless each segment has one
+        static int64_t segmentIndexSeconds(const std::filesystem::path &path);
+
+        // Writes the records of every segment next to path to out in the order they were logged, out already holding
+        // offset bytes, and adds each to index when one is given. On an invalid segment it writes nothing, returns
+        // false and leaves segments at the one that failed
+        static bool mergeSegments(const std::filesystem::path &path, std::ostream &out, const uint64_t offset, LogIndex *index, size_t &segments, size_t &records);
+
+        // Removes the segments next to path from the given shard on, along with their indexes
+        static void removeSegments(const std::filesystem::path &path, const size_t first = 0);
+
+    private:
+        struct FramedRecord
+        {
+            uint64_t timestamp;
+            std::string text;
+            RecordMeta meta;
+        };
+
+        struct Shard
+        {
+            std::mutex queueMutex;
+            std::condition_variable ready;
+            std::condition_variable drained;
+            std::deque<FramedRecord> records;
+            uint64_t enqueued = 0;
+            uint64_t written = 0;
+            bool stop = false;
+
+            std::mutex writerMutex;
+            std::ofstream stream;
+            std::unique_ptr<UringFileSink> uringSink;
+            std::unique_ptr<LogIndex> index;
+            std::filesystem::path segment;
+            uint64_t sequence = 0;
+            uint64_t bytes = 0;
+
+            std::vector<int> cpus;
+            std::thread worker;
+        };
+
+        std::vector<std::unique_ptr<Shard>> shards;
+        std::vector<size_t> cpuToShard;
+        size_t shardCapacity;
+        std::atomic<int64_t> writeLatencyTotal;
+        std::atomic<int64_t> writeLatencyCount;
+
+        void drainShard(const size_t index);
+
+        void writeFramed(const size_t index, const std::deque<FramedRecord> &batch);
+
+        size_t currentShard() const;
+
+        static std::vector<std::vector<int>> discoverTopology(const Granularity granularity);
+
+        static std::vector<int> parseCpuList(const std::string &list);
+    };
+}
@@ -0,0 +1,69 @@
+#include "../shardsink.h"
+#include "../logindex.h"
+
+#include <iostream>
+
+// Rebuilds the single ordered LaTeX document from the segments a sharded log left behind, which only happens when
+// it ended in a fatal or a crash. When every segment has a sidecar index, the merged document gets one too.
+//
+//     logmerge logs/main.tex [logs/main.merged.tex]
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <log.tex> [output.tex]\n";
+
+        return 2;
+    }
+
+    const std::filesystem::path log = argv[1];
+
+    std::filesystem::path output = log;
+
+    output.replace_filename(log.stem().string() + ".merged" + log.extension().string());
+
+    if (argc > 2)
+        output = argv[2];
+
+    if (!std::filesystem::exists(Logging::ShardedFileSink::segmentPath(log, 0)))
+    {
+        std::cerr << "No segments found next to " << log.string() << "\n";
+
+        return 1;
+    }
+
+    std::ofstream merged(output, std::ios::out | std::ios::trunc | std::ios::binary);
+
+    // Anything written before sharding was enabled stays at the front
+    std::ifstream prefix(log, std::ios::in | std::ios::binary);
+
+    if (prefix.peek() != std::ifstream::traits_type::eof())
+        merged << prefix.rdbuf();
+
+    const uint64_t prefixBytes = std::filesystem::exists(log) ? std::filesystem::file_size(log) : 0;
+
+    const int64_t bucketSeconds = Logging::ShardedFileSink::segmentIndexSeconds(log);
+
+    std::unique_ptr<Logging::LogIndex> index;
+
+    if (bucketSeconds > 0)
+        index = std::make_unique<Logging::LogIndex>(output, bucketSeconds, 0);
+
+    size_t segments = 0;
+    size_t frames = 0;
+
+    if (!Logging::ShardedFileSink::mergeSegments(log, merged, prefixBytes, index.get(), segments, frames))
+    {
+        std::cerr << Logging::ShardedFileSink::segmentPath(log, segments).string() << " is not a valid log segment\n";
+
+        return 1;
+    }
+
+    if (index)
+        index->save();
+
+    std::cout << "Merged " << frames << " records from " << segments << " segments into " << output.string() << "\n";
+
+    return merged ? 0 : 1;
+}
@@ -0,0 +1,295 @@
+#include "../logindex.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+// Answers queries against a log through its sidecar index, only touching the records that match.
+//
+//     logq logs/main.tex --level WARN+ --section LOGGER --from 10:00 --to 10:05 [--latex]
+//
+// A level without the trailing + matches that level only. Times are read on the day of the first record.
+
+namespace
+{
+    const char *LEVEL_NAMES[Logging::LogIndex::LEVEL_COUNT] = {"INFO", "TEST_SUCCESS", "WARN", "TEST_FAILURE", "FATAL"};
+
+    // Points into argv, which outlives the query
+    struct Query
+    {
+        const char *log = nullptr;
+        uint32_t lowestLevel = 0;
+        uint32_t highestLevel = Logging::LogIndex::LEVEL_COUNT - 1;
+        bool levelSet = false;
+        bool sectionSet = false;
+        const char *section = nullptr;
+        const char *from = nullptr;
+        const char *to = nullptr;
+        bool latex = false;
+    };
+
+    void usage(const char *program)
+    {
+        std::cerr << "usage: " << program << " <log.tex> [--level LEVEL[+]] [--section NAME] [--from HH:MM[:SS]] [--to HH:MM[:SS]] [--latex]\n";
+    }
+
+    bool parseLevel(std::string name, Query &query)
+    {
+        const bool andAbove = !name.empty() && name.back() == '+';
+
+        if (andAbove)
+            name.pop_back();
+
+        for (uint32_t level = 0; level < Logging::LogIndex::LEVEL_COUNT; level++)
+        {
+            if (name == LEVEL_NAMES[level])
+            {
+                query.lowestLevel = level;
+                query.highestLevel = andAbove ? Logging::LogIndex::LEVEL_COUNT - 1 : level;
+                query.levelSet = true;
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool parseTime(const char *clock, const time_t day, int64_t &result)
+    {
+        if (clock == nullptr)
+            return true;
+
+        int hour = 0, minute = 0, second = 0;
+
+        if (std::sscanf(clock, "%d:%d:%d", &hour, &minute, &second) < 2)
+            return false;
+
+        time_t reference = day;
+
+        tm local;
+
+        localtime_r(&reference, &local);
+
+        local.tm_hour = hour;
+        local.tm_min = minute;
+        local.tm_sec = second;
+        local.tm_isdst = -1;
+
+        result = mktime(&local);
+
+        return true;
+    }
+
+    // The record as written, minus the \hspace and \textcolor wrapping
+    std::string plainText(const std::string &record)
+    {
+        const size_t color = record.find("\\textcolor{");
+
+        if (color == std::string::npos)
+            return record;
+
+        const size_t open = record.find("}{", color);
+        const size_t close = record.rfind('}');
+
+        if (open == std::string::npos || close == std::string::npos || close < open + 2)
+            return record;
+
+        return record.substr(open + 2, close - open - 2);
+    }
+
+    std::vector<uint64_t> mergeLists(const std::vector<std::vector<uint64_t>> &lists)
+    {
+        std::vector<uint64_t> merged;
+
+        for (const std::vector<uint64_t> &list : lists)
+        {
+            std::vector<uint64_t> combined;
+
+            std::merge(merged.begin(), merged.end(), list.begin(), list.end(), std::back_inserter(combined));
+
+            merged.swap(combined);
+        }
+
+        return merged;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        usage(argv[0]);
+
+        return 2;
+    }
+
+    Query query;
+
+    query.log = argv[1];
+
+    for (int i = 2; i < argc; i++)
+    {
+        const std::string option = argv[i];
+
+        if (option == "--latex")
+            query.latex = true;
+        else if (i + 1 >= argc)
+        {
+            usage(argv[0]);
+
+            return 2;
+        }
+        else if (option == "--level")
+        {
+            if (!parseLevel(argv[++i], query))
+            {
+                std::cerr << argv[i] << " is not a level, use one of INFO, TEST_SUCCESS, WARN, TEST_FAILURE or FATAL\n";
+
+                return 2;
+            }
+        }
+        else if (option == "--section")
+        {
+            query.section = argv[++i];
+            query.sectionSet = true;
+        }
+        else if (option == "--from")
+            query.from = argv[++i];
+        else if (option == "--to")
+            query.to = argv[++i];
+        else
+        {
+            usage(argv[0]);
+
+            return 2;
+        }
+    }
+
+    const Logging::LogIndexView index(query.log);
+
+    if (!index.isValid())
+    {
+        std::cerr << "No usable index at " << Logging::LogIndex::sidecarPath(query.log).string() << ", enable it with Log::setIndexing\n";
+
+        return 1;
+    }
+
+    const Logging::MappedFile log(query.log);
+
+    if (log.getData() == nullptr && index.getEntryCount() > 0)
+    {
+        std::cerr << "Unable to read " << query.log << "\n";
+
+        return 1;
+    }
+
+    const time_t day = index.getEntryCount() > 0 ? index.getEntry(0).time : 0;
+
+    int64_t from = INT64_MIN;
+    int64_t to = INT64_MAX;
+
+    if (!parseTime(query.from, day, from) || !parseTime(query.to, day, to))
+    {
+        std::cerr << "Times are given as HH:MM or HH:MM:SS\n";
+
+        return 2;
+    }
+
+    // Start from the narrowest list the index offers
+    std::vector<uint64_t> candidates;
+
+    if (query.sectionSet)
+    {
+        for (uint64_t section = 0; section < index.getSectionCount(); section++)
+            if (index.getSectionName(section) == std::string(query.section))
+                candidates = index.getSectionEntries(section);
+    }
+    else if (query.levelSet)
+    {
+        std::vector<std::vector<uint64_t>> lists;
+
+        for (uint32_t level = query.lowestLevel; level <= query.highestLevel; level++)
+            lists.push_back(index.getLevelEntries(level));
+
+        candidates = mergeLists(lists);
+    }
+    else
+    {
+        for (uint64_t id = 0; id < index.getEntryCount(); id++)
+            candidates.push_back(id);
+    }
+
+    const uint64_t firstEntry = from == INT64_MIN ? 0 : index.getFirstEntryAt(from);
+
+    // Summarised entries from lastEntry on are all newer than --to, only the ones after the tables still need a look
+    const uint64_t summarised = index.getSummarisedCount();
+    const uint64_t lastEntry = to == INT64_MAX ? summarised : index.getLastEntryAt(to);
+
+    if (query.latex && log.getData())
+    {
+        const std::string head(log.getData(), std::min(log.getLength(), static_cast<size_t>(64 * 1024)));
+
+        const size_t title = head.find("\\maketitle\n\n");
+
+        if (title != std::string::npos)
+            std::cout << head.substr(0, title + std::strlen("\\maketitle\n\n"));
+    }
+
+    bool sectionOpen = false;
+    uint32_t currentSection = 0;
+    uint64_t matches = 0;
+
+    for (std::vector<uint64_t>::const_iterator id = std::lower_bound(candidates.begin(), candidates.end(), firstEntry); id != candidates.end(); id++)
+    {
+        if (*id >= lastEntry && *id < summarised)
+        {
+            id = std::lower_bound(id, candidates.cend(), summarised);
+
+            if (id == candidates.end())
+                break;
+        }
+
+        const Logging::LogIndex::Entry &entry = index.getEntry(*id);
+
+        if (entry.time < from || entry.time > to || entry.level < query.lowestLevel || entry.level > query.highestLevel)
+            continue;
+
+        if (entry.offset + entry.length > log.getLength())
+            continue;
+
+        const std::string record(log.getData() + entry.offset, entry.length);
+
+        if (query.latex)
+        {
+            if (!sectionOpen || entry.section != currentSection)
+            {
+                if (sectionOpen)
+                    std::cout << "\\end{flushleft}\n\n";
+
+                std::cout << "\\section{" << index.getSectionName(entry.section) << "}\n\n\\begin{flushleft}\n\n";
+
+                sectionOpen = true;
+                currentSection = entry.section;
+            }
+
+            std::cout << record;
+        }
+        else
+            std::cout << plainText(record) << "\n";
+
+        matches++;
+    }
+
+    if (query.latex)
+    {
+        if (sectionOpen)
+            std::cout << "\\end{flushleft}";
+
+        std::cout << "\\end{document}\n";
+    }
+
+    std::cerr << matches << " matching records\n";
+
+    return 0;
+}
@@ -0,0 +1,381 @@
+#include "uringsink.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define LG_HAS_URING 1
+#else
+#define LG_HAS_URING 0
+#endif
+
+namespace
+{
+    template <typename T>
+    T *ringPointer(void *base, const unsigned offset)
+    {
+        return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+    }
+
+    unsigned loadAcquire(const unsigned *value)
+    {
+        return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+    }
+
+    void storeRelease(unsigned *value, const unsigned newValue)
+    {
+        __atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+    }
+}
+
+Logging::UringFileSink::UringFileSink(const std::filesystem::path &path, const size_t size, const unsigned bufferCount, const bool allowUring) : fileDescriptor(-1), fileOffset(0), bufferSize(size), current(0), inFlightCount(0), uring(false)
+{
+    // No O_APPEND, io_uring would then order the writes by completion instead of by offset
+    fileDescriptor = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+
+    // Left unusable, the owner checks isOpen and falls back to a stream
+    if (fileDescriptor < 0)
+        return;
+
+    fileOffset = static_cast<uint64_t>(lseek(fileDescriptor, 0, SEEK_END));
+
+    for (unsigned i = 0; i < (bufferCount < 2 ? 2 : bufferCount); i++)
+    {
+        char *data = static_cast<char *>(std::aligned_alloc(4096, (bufferSize + 4095) / 4096 * 4096));
+
+        if (data == nullptr)
+            throw std::bad_alloc();
+
+        buffers.push_back({data, 0, 0, false});
+    }
+
+    if (allowUring)
+        uring = setupRing(static_cast<unsigned>(buffers.size()));
+}
+
+Logging::UringFileSink::~UringFileSink()
+{
+    if (!isOpen())
+        return;
+
+    flush();
+
+    teardownRing();
+
+    for (Buffer &buffer : buffers)
+        std::free(buffer.data);
+
+    close(fileDescriptor);
+}
+
+void Logging::UringFileSink::write(const std::string &text)
+{
+    size_t copied = 0;
+
+    while (copied < text.length())
+    {
+        Buffer &buffer = buffers[current];
+
+        const size_t chunk = std::min(bufferSize - buffer.used, text.length() - copied);
+
+        std::memcpy(buffer.data + buffer.used, text.data() + copied, chunk);
+
+        buffer.used += chunk;
+        copied += chunk;
+
+        if (buffer.used == bufferSize)
+        {
+            submit(current);
+
+            current = nextFreeBuffer();
+        }
+    }
+
+    if (uring && inFlightCount > 0)
+        reap(false);
+}
+
+void Logging::UringFileSink::flush()
+{
+    if (buffers[current].used > 0)
+        submit(current);
+
+    if (uring)
+    {
+        while (inFlightCount > 0)
+            reap(true);
+
+        current = nextFreeBuffer();
+    }
+    else
+    {
+        writeSynchronously(0, current + (buffers[current].inFlight ? 1 : 0));
+
+        current = 0;
+    }
+}
+
+bool Logging::UringFileSink::usingUring() const
+{
+    return uring;
+}
+
+bool Logging::UringFileSink::isOpen() const
+{
+    return fileDescriptor >= 0;
+}
+
+bool Logging::UringFileSink::setupRing(const unsigned entries)
+{
+#if LG_HAS_URING
+    io_uring_params params;
+
+    std::memset(&params, 0, sizeof(params));
+
+    ring.fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+
+    if (ring.fd < 0)
+        return false;
+
+    ring.sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ring.sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring.sqMapSize = ring.cqMapSize = std::max(ring.sqMapSize, ring.cqMapSize);
+
+    ring.sqMap = mmap(nullptr, ring.sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+
+    if (ring.sqMap == MAP_FAILED)
+    {
+        ring.sqMap = nullptr;
+        teardownRing();
+
+        return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring.cqMap = ring.sqMap;
+    else
+    {
+        ring.cqMap = mmap(nullptr, ring.cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+
+        if (ring.cqMap == MAP_FAILED)
+        {
+            ring.cqMap = nullptr;
+            teardownRing();
+
+            return false;
+        }
+    }
+
+    ring.sqes = mmap(nullptr, ring.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+
+    if (ring.sqes == MAP_FAILED)
+    {
+        ring.sqes = nullptr;
+        teardownRing();
+
+        return false;
+    }
+
+    ring.sqHead = ringPointer<unsigned>(ring.sqMap, params.sq_off.head);
+    ring.sqTail = ringPointer<unsigned>(ring.sqMap, params.sq_off.tail);
+    ring.sqMask = ringPointer<unsigned>(ring.sqMap, params.sq_off.ring_mask);
+    ring.sqArray = ringPointer<unsigned>(ring.sqMap, params.sq_off.array);
+    ring.cqHead = ringPointer<unsigned>(ring.cqMap, params.cq_off.head);
+    ring.cqTail = ringPointer<unsigned>(ring.cqMap, params.cq_off.tail);
+    ring.cqMask = ringPointer<unsigned>(ring.cqMap, params.cq_off.ring_mask);
+    ring.cqes = ringPointer<void>(ring.cqMap, params.cq_off.cqes);
+
+    std::vector<iovec> registered;
+
+    for (const Buffer &buffer : buffers)
+        registered.push_back({buffer.data, bufferSize});
+
+    if (syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_BUFFERS, registered.data(), registered.size()) < 0)
+    {
+        teardownRing();
+
+        return false;
+    }
+
+    return true;
+#else
+    static_cast<void>(entries);
+
+    return false;
+#endif
+}
+
+void Logging::UringFileSink::teardownRing()
+{
+    if (ring.sqes)
+        munmap(ring.sqes, ring.sqesSize);
+
+    if (ring.cqMap && ring.cqMap != ring.sqMap)
+        munmap(ring.cqMap, ring.cqMapSize);
+
+    if (ring.sqMap)
+        munmap(ring.sqMap, ring.sqMapSize);
+
+    if (ring.fd >= 0)
+        close(ring.fd);
+
+    ring = Ring();
+}
+
+void Logging::UringFileSink::submit(const size_t index)
+{
+    Buffer &buffer = buffers[index];
+
+    buffer.offset = fileOffset;
+    buffer.inFlight = true;
+
+    fileOffset += buffer.used;
+
+    // Without a ring the full buffers are gathered and written once no free buffer is left
+    if (!uring)
+        return;
+
+#if LG_HAS_URING
+    const unsigned tail = *ring.sqTail;
+    const unsigned slot = tail & *ring.sqMask;
+
+    io_uring_sqe *sqe = static_cast<io_uring_sqe *>(ring.sqes) + slot;
+
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = fileDescriptor;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer.data);
+    sqe->len = static_cast<uint32_t>(buffer.used);
+    sqe->off = buffer.offset;
+    sqe->buf_index = static_cast<uint16_t>(index);
+    sqe->user_data = index;
+
+    ring.sqArray[slot] = slot;
+
+    storeRelease(ring.sqTail, tail + 1);
+
+    if (syscall(__NR_io_uring_enter, ring.fd, 1, 0, 0, nullptr, 0) != 1)
+    {
+        // Take the entry back so a later enter cannot submit it once the buffer has been reused, then write
+        // this buffer the slow way instead
+        storeRelease(ring.sqTail, tail);
+
+        writeSynchronously(index, 1);
+
+        return;
+    }
+
+    inFlightCount++;
+#endif
+}
+
+void Logging::UringFileSink::reap(const bool wait)
+{
+#if LG_HAS_URING
+    if (wait && loadAcquire(ring.cqTail) == *ring.cqHead)
+        syscall(__NR_io_uring_enter, ring.fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+    unsigned head = *ring.cqHead;
+
+    while (head != loadAcquire(ring.cqTail))
+    {
+        const io_uring_cqe *cqe = static_cast<io_uring_cqe *>(ring.cqes) + (head & *ring.cqMask);
+
+        Buffer &buffer = buffers[static_cast<size_t>(cqe->user_data)];
+
+        if (cqe->res < 0)
+            writeRemainder(buffer, 0);
+        else if (static_cast<size_t>(cqe->res) < buffer.used)
+            writeRemainder(buffer, static_cast<size_t>(cqe->res));
+
+        buffer.used = 0;
+        buffer.inFlight = false;
+
+        inFlightCount--;
+        head++;
+    }
+
+    storeRelease(ring.cqHead, head);
+#else
+    static_cast<void>(wait);
+#endif
+}
+
+void Logging::UringFileSink::writeSynchronously(const size_t first, const size_t count)
+{
+    if (count == 0)
+        return;
+
+    std::vector<iovec> pending;
+
+    for (size_t i = first; i < first + count; i++)
+        pending.push_back({buffers[i].data, buffers[i].used});
+
+    const ssize_t written = pwritev(fileDescriptor, pending.data(), static_cast<int>(pending.size()), static_cast<off_t>(buffers[first].offset));
+
+    size_t remaining = written < 0 ? 0 : static_cast<size_t>(written);
+
+    for (size_t i = first; i < first + count; i++)
+    {
+        if (remaining < buffers[i].used)
+            writeRemainder(buffers[i], remaining);
+
+        remaining -= std::min(remaining, buffers[i].used);
+
+        buffers[i].used = 0;
+        buffers[i].inFlight = false;
+    }
+}
+
+void Logging::UringFileSink::writeRemainder(const Buffer &buffer, const size_t written)
+{
+    size_t done = written;
+
+    while (done < buffer.used)
+    {
+        const ssize_t result = pwrite(fileDescriptor, buffer.data + done, buffer.used - done, static_cast<off_t>(buffer.offset + done));
+
+        if (result <= 0)
+            break;
+
+        done += static_cast<size_t>(result);
+    }
+}
+
+size_t Logging::UringFileSink::nextFreeBuffer()
+{
+    if (!uring)
+    {
+        if (current + 1 < buffers.size())
+            return current + 1;
+
+        writeSynchronously(0, buffers.size());
+
+        return 0;
+    }
+
+    while (true)
+    {
+        for (size_t i = 1; i <= buffers.size(); i++)
+        {
+            const size_t index = (current + i) % buffers.size();
+
+            if (!buffers[index].inFlight)
+                return index;
+        }
+
+        reap(true);
+    }
+}
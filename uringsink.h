@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <cstddef>
+#include <cstdint>
+
+namespace Logging
+{
+
+    // Append-only file writer that batches records into a ring of registered buffers and submits full
+    // buffers through io_uring without waiting for them. Falls back to gathering the buffers into a single
+    // pwritev when io_uring cannot be set up.
+    class UringFileSink
+    {
+    public:
+        UringFileSink(const std::filesystem::path &path, const size_t bufferSize = 64 * 1024, const unsigned bufferCount = 4, const bool allowUring = true);
+        ~UringFileSink();
+
+        UringFileSink(const UringFileSink &) = delete;
+        UringFileSink &operator=(const UringFileSink &) = delete;
+
+        void write(const std::string &text);
+
+        void flush();
+
+        bool usingUring() const;
+
+        // False when the file could not be opened, nothing may be written then
+        bool isOpen() const;
+
+    private:
+        struct Buffer
+        {
+            char *data;
+            size_t used;
+            uint64_t offset;
+            bool inFlight;
+        };
+
+        struct Ring
+        {
+            int fd = -1;
+
+            void *sqMap = nullptr;
+            void *cqMap = nullptr;
+            void *sqes = nullptr;
+            size_t sqMapSize = 0;
+            size_t cqMapSize = 0;
+            size_t sqesSize = 0;
+
+            unsigned *sqHead = nullptr;
+            unsigned *sqTail = nullptr;
+            unsigned *sqMask = nullptr;
+            unsigned *sqArray = nullptr;
+            unsigned *cqHead = nullptr;
+            unsigned *cqTail = nullptr;
+            unsigned *cqMask = nullptr;
+            void *cqes = nullptr;
+        };
+
+        int fileDescriptor;
+        uint64_t fileOffset;
+        size_t bufferSize;
+        std::vector<Buffer> buffers;
+        size_t current;
+        unsigned inFlightCount;
+        Ring ring;
+        bool uring;
+
+        bool setupRing(const unsigned entries);
+        void teardownRing();
+
+        void submit(const size_t index);
+        void reap(const bool wait);
+        void writeSynchronously(const size_t first, const size_t count);
+        void writeRemainder(const Buffer &buffer, const size_t written);
+
+        size_t nextFreeBuffer();
+    };
+}